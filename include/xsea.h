@@ -6,7 +6,15 @@
 #include <memory>
 #include <fstream>
 #include <stack>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <utility>
 
 namespace Xsea {
 
@@ -26,8 +34,53 @@ class Text;
 
 class Unknown;
 
+class CData;
+
+class ProcessingInstruction;
+
+class DocType;
+
 class Attribute;
 
+class StringRef;
+
+class MappedFile;
+
+class NameTable;
+
+class NodeStore;
+
+class Tokenizer;
+
+class Reader;
+
+class SaxHandler;
+
+class SaxParser;
+
+class PushParser;
+
+class DocumentBatch;
+
+class OutputBuffer;
+
+class XmlWriter;
+
+class CompactDocument;
+
+class CompactNode;
+
+class Query;
+
+class ElementIndex;
+
+class PathHandler;
+
+class PathFilter;
+
+template<class T>
+class NodeRange;
+
 // type alias
 typedef std::shared_ptr<Node> NodePtr;
 typedef std::shared_ptr<Declaration> DeclarationPtr;
@@ -36,11 +89,282 @@ typedef std::shared_ptr<Nonelement> NonelementPtr;
 typedef std::shared_ptr<Comment> CommentPtr;
 typedef std::shared_ptr<Text> TextPtr;
 typedef std::shared_ptr<Unknown> UnknownPtr;
+typedef std::shared_ptr<CData> CDataPtr;
+typedef std::shared_ptr<ProcessingInstruction> ProcessingInstructionPtr;
+typedef std::shared_ptr<DocType> DocTypePtr;
 typedef std::shared_ptr<Attribute> AttributePtr;
+typedef std::shared_ptr<NameTable> NameTablePtr;
+typedef std::shared_ptr<NodeStore> NodeStorePtr;
+
+typedef std::uint32_t NameId; // an interned tag or attribute name
+const NameId noName = 0xFFFFFFFFu;
+
+// non-owning handles, valid while the node stays in its tree
+typedef Node *NodeHandle;
+typedef Element *ElementHandle;
+
+
+enum class NodeType { // new types go at the end, snapshots store the numbers
+    _node, _declaration, _element, _nonelement, _comment, _text, _unknown, _back, _cdata, _instruction, _doctype
+};
+
+// non-owning view of characters, e.g. a value inside the buffer of an in-situ Document
+class StringRef {
+public:
+    StringRef() = default;
+
+    StringRef(const char *data, std::size_t size) : _data(data), _size(size) {}
+
+    StringRef(const char *str) : _data(str), _size(std::strlen(str)) {}
+
+    StringRef(const std::string &str) : _data(str.data()), _size(str.size()) {}
+
+    const char *data() const { return _data; }
+
+    std::size_t size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+    const char *begin() const { return _data; }
+
+    const char *end() const { return _data + _size; }
+
+    char operator[](std::size_t i) const { return _data[i]; }
+
+    char back() const { return _data[_size - 1]; }
+
+    StringRef substr(std::size_t pos, std::size_t n = std::string::npos) const {
+        if (pos > _size) pos = _size;
+        return StringRef(_data + pos, n < _size - pos ? n : _size - pos);
+    }
+
+    std::string str() const { return std::string(_data, _size); }
+
+    bool operator==(const StringRef &rhs) const {
+        return _size == rhs._size && (_size == 0 || std::memcmp(_data, rhs._data, _size) == 0);
+    }
+
+    bool operator!=(const StringRef &rhs) const { return !(*this == rhs); }
+
+private:
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const StringRef &ref) {
+    return os.write(ref.data(), static_cast<std::streamsize>(ref.size()));
+}
+
+// read-only view of a whole file, memory mapped where the platform supports it
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &fileName);
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    // observer
+    bool isOpen() const;
+
+    const char *data() const;
+
+    std::size_t size() const;
+
+    // modifier
+    void adviseSequential(bool sequential) const; // hint the page cache while scanning front to back
+
+private:
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+    bool _open = false;
+    std::string _fallback; // whole file read into memory when mmap is unavailable
+};
+
+// collects output and hands it to a file descriptor, a stream or a string in large pieces
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd);
+
+    explicit OutputBuffer(std::ostream &os);
+
+    explicit OutputBuffer(std::string &out); // append to out, nothing is buffered in between
+
+    OutputBuffer(const OutputBuffer &) = delete;
+
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    ~OutputBuffer();
+
+    // io
+    void put(char c) { _target->push_back(c); }
+
+    void put(const char *data, std::size_t size) {
+        _target->append(data, size);
+        if (_target == &_buffer && _buffer.size() >= flushSize)
+            flush();
+    }
+
+    void put(StringRef str) { put(str.data(), str.size()); }
+
+    void putEscaped(StringRef str, bool attribute); // & < > in text, & < " in attribute values
+    void putCData(StringRef str); // <![CDATA[str]]>, a ]]> inside is split over two sections
+
+    bool flush();
+
+    // observer
+    bool good() const;
+
+    static std::size_t escapedSize(StringRef str, bool attribute);
+
+private:
+    static const std::size_t flushSize = 1 << 16;
+
+    std::string _buffer;
+    std::string *_target; // _buffer, or the caller's string
+    std::ostream *_os = nullptr;
+    int _fd = -1;
+    bool _good = true;
+};
+
+// interns tag and attribute names to small ids, not thread safe, may be shared between Documents
+class NameTable {
+public:
+    NameTable() = default;
+
+    NameTable(const NameTable &) = delete;
 
+    NameTable &operator=(const NameTable &) = delete;
 
-enum class NodeType {
-    _node, _declaration, _element, _nonelement, _comment, _text, _unknown, _back
+    friend class Element;
+
+    // modifier
+    NameId intern(StringRef name); // add the name when it is new
+
+    // observer
+    NameId find(StringRef name) const; // noName when it was never interned
+    StringRef name(NameId id) const; // stable as long as the table lives
+    std::size_t size() const;
+
+    // the parts of a qualified name, split on the first ask and interned
+    NameId prefixOf(NameId id); // before the colon, noName when there is none
+    NameId localOf(NameId id); // after the colon, the name itself when there is none
+
+private:
+    static const std::size_t chunkSize = 16 * 1024;
+
+    std::vector<NameId> _slots; // open addressing, id + 1 or 0 for an empty slot
+    std::vector<StringRef> _names;
+    std::vector<std::pair<NameId, NameId>> _parts; // prefix and local part by id, noName local until split
+    std::vector<std::unique_ptr<char[]>> _chunks;
+    char *_cursor = nullptr;
+    char *_limit = nullptr;
+
+    static std::size_t hash(StringRef name);
+
+    void grow();
+
+    const std::pair<NameId, NameId> &parts(NameId id);
+};
+
+// monotonic arena with per-size free lists, every node of a Document lives in one
+class NodeStore : public std::enable_shared_from_this<NodeStore> {
+public:
+    // allocator for the shared_ptr control blocks, it keeps the store alive for every node
+    template<class T>
+    class Allocator {
+    public:
+        typedef T value_type;
+
+        explicit Allocator(NodeStorePtr store) : _store(std::move(store)) {}
+
+        template<class U>
+        Allocator(const Allocator<U> &other) : _store(other._store) {}
+
+        T *allocate(std::size_t n) { return static_cast<T *>(_store->allocate(n * sizeof(T))); }
+
+        void deallocate(T *p, std::size_t n) { _store->deallocate(p, n * sizeof(T)); }
+
+        template<class U>
+        bool operator==(const Allocator<U> &rhs) const { return _store == rhs._store; }
+
+        template<class U>
+        bool operator!=(const Allocator<U> &rhs) const { return _store != rhs._store; }
+
+    private:
+        template<class U> friend class Allocator;
+
+        NodeStorePtr _store;
+    };
+
+    explicit NodeStore(NameTablePtr names);
+
+    NodeStore(const NodeStore &) = delete;
+
+    NodeStore &operator=(const NodeStore &) = delete;
+
+    ~NodeStore(); // bulk free of every block
+
+    void *allocate(std::size_t size);
+
+    void deallocate(void *p, std::size_t size);
+
+    void retain(std::shared_ptr<void> input); // keep an input buffer alive as long as the nodes
+
+    StringRef keep(StringRef text); // copy into the arena, lives as long as the store
+
+    NameTable &names(); // the names of the elements and attributes in this store
+
+    ElementIndex *index() const; // the lookups of the Document that made this store, nullptr until built
+    void setIndex(ElementIndex *index);
+
+    template<class T>
+    static std::shared_ptr<T> make(const NodeStorePtr &store, Element *parent, std::size_t index);
+
+    template<class T>
+    static std::shared_ptr<T> make(const NodeStorePtr &store, Element *parent, std::size_t index,
+                                   const std::string &value);
+
+private:
+    static const std::size_t blockSize = 64 * 1024;
+    static const std::size_t granule = 16;
+    static const std::size_t classes = 32; // sizes up to 512 bytes are recycled
+
+    template<class T>
+    static std::shared_ptr<T> adopt(const NodeStorePtr &store, T *node);
+
+    std::vector<char *> _blocks;
+    char *_cursor = nullptr;
+    char *_limit = nullptr;
+    void *_free[classes] = {}; // intrusive free list heads by size class
+    std::vector<std::shared_ptr<void>> _inputs;
+    NameTablePtr _names;
+    ElementIndex *_index = nullptr;
+    char *_textCursor = nullptr; // characters are packed apart from the nodes
+    char *_textLimit = nullptr;
+};
+
+// how a Document parses its input
+// what becomes of whitespace in text, blank text outside the root element is always dropped
+enum class Whitespace {
+    _preserve, // every text as it is, blank ones between tags included
+    _drop, // blank text between tags is skipped before anything is made for it
+    _normalize // as _drop, other text is trimmed and its inner runs of whitespace become one space
+};
+
+struct ParseOptions {
+    unsigned threads = 1; // in-situ loads of large inputs are tokenized on this many threads, 0 for all cores
+    Whitespace whitespace = Whitespace::_drop;
+};
+
+// how a Document is written out
+struct SaveOptions {
+    bool pretty = true; // one node per line, false writes no whitespace at all
+    unsigned indent = 2; // spaces per level in pretty mode
 };
 
 class Document {
@@ -52,16 +376,22 @@ private:
     // data
     std::string _filename;
     std::string _error;
+    NodeStorePtr _store; // owns the nodes and the in-situ input they refer into
+    NameTablePtr _names;
+    ParseOptions _options;
+    std::shared_ptr<ElementIndex> _index; // built by the first indexed lookup, dropped by a load
+
+    class Builder; // SaxHandler building the tree
+    class Feed; // an incremental load in progress
+    class Serializer; // writes the tree to an OutputBuffer
+    class SnapshotWriter; // flattens the tree into a CompactDocument snapshot
+
+    std::shared_ptr<Feed> _feed; // between the first feed and finish
 
     // utility member function
     bool construct(std::istream &is); // construct the DOM tree
-    inline static std::size_t startLine(const std::string &line); // jump off the space chars
-    inline static NodeType judgeType(const std::string &line, std::size_t start); // judge the type
-    inline static std::string tagName(const std::string &line, std::size_t start = 0); // get the tag name between <>
-    inline static std::string parseComment(const std::string &line, std::size_t start); // get comment value
-    inline static std::string parseText(const std::string &line); // get text value
-    static void save(std::ostream &os, ElementPtr ptr, int indent = 0);
-    inline static void save(std::ostream &os, NonelementPtr ptr);
+    bool construct(const char *begin, const char *end); // construct in situ, values refer into the input
+    void reset(); // drop the current tree
 
 public:
     // constructor
@@ -80,15 +410,30 @@ public:
     bool loadFile(const char *fileName); // load according to the parameter
     bool loadFile(const std::string &fileName); // load according to the parameter
     bool load(std::istream &is);
+    bool loadBuffer(const char *data, std::size_t size); // copy once, then parse in situ
+    bool loadBuffer(std::string &&buffer); // take over the buffer and parse in situ
+    bool mapFile(); // map the file according to the filename and parse in situ
+    bool mapFile(const char *fileName); // map according to the parameter
+    bool mapFile(const std::string &fileName); // map according to the parameter
+    bool feed(const char *data, std::size_t size); // load chunk by chunk, the first feed drops the old tree
+    bool finish(); // the fed input is complete, false on an error such as an unclosed tag
 
     // save
     void saveFile() const; // save the file according to the filename when loaded
     void saveFile(const char *fileName) const; // save the file according to the parameter
     void saveFile(const std::string &fileName) const; // same as above
+    void saveFile(const std::string &fileName, const SaveOptions &options) const;
+    void save(std::ostream &os, const SaveOptions &options = SaveOptions()) const;
+    void saveBuffer(std::string &out, const SaveOptions &options = SaveOptions()) const; // append to out
+    bool saveBinary(const std::string &fileName) const; // snapshot that CompactDocument maps
+    void saveBinary(std::string &out) const; // append the snapshot to out
+    bool loadBinary(const std::string &fileName); // map a snapshot and rebuild the tree, values stay in the mapping
 
     // observer
     ElementPtr getRootPtr() const;
 
+    ElementHandle getRootHandle() const;
+
     ElementPtr getRootPtr();
 
     const Element &getRoot() const;
@@ -110,36 +455,343 @@ public:
     std::string getError() const;
 
     const char *getErrorC() const;
+
+    NameTablePtr getNameTable() const;
+
+    // modifier
+    void setNameTable(NameTablePtr names); // share names with other Documents, takes effect on the next load
+    void setParseOptions(const ParseOptions &options);
+
+    const ParseOptions &getParseOptions() const;
+
+    // indexed lookups, built on the first call and kept current by the edits, valid until the next edit
+    const std::vector<ElementHandle> &findAll(StringRef tag); // every element with the tag, in document order
+    const std::vector<ElementHandle> &findAll(StringRef tag, StringRef key, StringRef value); // and key="value"
+    ElementHandle findFirst(StringRef tag, StringRef key, StringRef value); // nullptr when there is none
+    const std::vector<ElementHandle> &findAll(StringRef ns, StringRef local); // by namespace URI, "" for none
+    ElementHandle findFirst(StringRef ns, StringRef local);
+    void dropIndexes(); // free the lookups
+
+    friend class DocumentBatch;
+
+    friend class Query;
+};
+
+// loads many Documents at once, each Document interns into a NameTable of its own
+// so once loaded the Documents may be handed to different threads, the table is not thread safe
+class DocumentBatch {
+public:
+    explicit DocumentBatch(unsigned threads = 0); // 0 for all cores
+
+    static DocumentBatch loadMany(const std::vector<std::string> &fileNames, unsigned threads = 0);
+
+    // input
+    void addFile(const std::string &fileName);
+    void addBuffer(const char *data, std::size_t size); // the data must stay valid until load
+    void addBuffer(std::string &&buffer);
+
+    // io
+    bool load(); // parse every input added since the last load, false if any of them failed
+
+    // observer
+    std::size_t size() const;
+
+    Document &getDocument(std::size_t i); // shares nothing with the other Documents of the batch
+
+    const Document &getDocument(std::size_t i) const;
+
+    bool good(std::size_t i) const;
+
+    std::string getError(std::size_t i) const; // the error of one input, empty if it loaded
+
+    std::vector<std::size_t> getFailed() const; // indexes of the inputs that did not load
+
+private:
+    struct Input {
+        std::string fileName;
+        std::string buffer;
+        const char *data = nullptr; // borrowed input
+        std::size_t size = 0;
+        bool isFile = false;
+        bool owned = false; // the input is in buffer
+        bool done = false;
+        bool ok = false;
+    };
+
+    unsigned _threads;
+    std::vector<Input> _inputs;
+    std::vector<std::unique_ptr<Document>> _documents;
+
+    bool loadOne(Input &input, Document &doc);
 };
 
+// read-only tree in flat arrays, e.g. a binary snapshot of a Document mapped as it is
+class CompactDocument {
+public:
+    typedef std::uint32_t Index; // position of a node in document order
+    static const Index npos = 0xFFFFFFFFu;
+
+    // snapshot layout, every section starts at an offset aligned to 8 from the start of the file
+    static const std::uint32_t version = 2;
+
+    struct Header {
+        char magic[8]; // "XSEABIN"
+        std::uint32_t version;
+        std::uint32_t byteOrder; // 0x01020304 as written
+        std::uint32_t nodeCount;
+        std::uint32_t attributeCount;
+        std::uint32_t nameCount;
+        std::uint32_t reserved;
+        std::uint64_t nodes; // offsets of the sections
+        std::uint64_t attributes;
+        std::uint64_t names;
+        std::uint64_t strings;
+        std::uint64_t stringsSize;
+    };
+
+    struct NodeRecord {
+        std::uint32_t type; // NodeType
+        std::uint32_t name; // index into the names of an element, npos otherwise
+        Index parent;
+        Index firstChild;
+        Index lastChild;
+        Index previousSibling;
+        Index nextSibling;
+        std::uint32_t firstAttribute;
+        std::uint32_t attributeCount;
+        std::uint32_t valueSize;
+        std::uint64_t value; // offset into the strings, each string is followed by a NUL
+    };
+
+    struct AttributeRecord {
+        std::uint32_t name;
+        std::uint32_t valueSize;
+        std::uint64_t value;
+    };
+
+    struct NameRecord {
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint32_t reserved;
+    };
+
+    CompactDocument() = default;
+
+    // io, O(1): only the header and the section bounds are checked
+    bool mapFile(const std::string &fileName);
+    bool loadBuffer(std::string &&buffer);
+    bool loadDocument(const Document &doc); // flatten a tree in memory, O(n)
+
+    // observer
+    std::size_t size() const; // number of nodes, the document node 0 included
+
+    Index root() const; // the root element, npos when empty
+
+    CompactNode getRoot() const; // same as above as a node
+
+    CompactNode node(Index i) const;
+
+    NodeType type(Index i) const;
+
+    StringRef name(Index i) const; // tag of an element
+
+    StringRef value(Index i) const; // text of a non-element, the tag of an element
+
+    Index parent(Index i) const;
+
+    Index firstChild(Index i) const;
+
+    Index lastChild(Index i) const;
+
+    Index previousSibling(Index i) const;
+
+    Index nextSibling(Index i) const;
+
+    std::size_t attributeCount(Index i) const;
+
+    StringRef attributeKey(Index i, std::size_t n) const;
+
+    StringRef attributeValue(Index i, std::size_t n) const;
+
+    bool findAttribute(Index i, StringRef key, StringRef &value) const;
+
+    Index findFirst(Index i, StringRef name) const; // first descendant element with this tag
+
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    std::shared_ptr<void> _input; // the mapping or the buffer
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+    const Header *_header = nullptr;
+    const NodeRecord *_nodes = nullptr;
+    const AttributeRecord *_attributes = nullptr;
+    const NameRecord *_names = nullptr;
+    const char *_strings = nullptr;
+    std::string _error;
+
+    bool open(const char *data, std::size_t size);
+    StringRef string(std::uint64_t offset, std::uint32_t size) const;
+    bool fail(const std::string &message);
+
+    friend class Document;
+};
+
+// a node of a CompactDocument with the navigation of Node and Element, a small value valid as long as the document
+class CompactNode {
+public:
+    CompactNode() = default;
+
+    CompactNode(const CompactDocument *doc, CompactDocument::Index index) : _doc(doc), _index(index) {}
+
+    explicit operator bool() const { return _index != CompactDocument::npos; } // false past the last node
+
+    bool operator==(const CompactNode &rhs) const { return _doc == rhs._doc && _index == rhs._index; }
+
+    bool operator!=(const CompactNode &rhs) const { return !(*this == rhs); }
+
+    // observer
+    CompactDocument::Index position() const { return _index; } // in document order
+
+    NodeType getType() const;
+
+    std::string getValue() const;
+
+    const char *getValueC() const; // values are NUL terminated in place
+
+    StringRef getValueRef() const;
+
+    CompactNode getParent() const; // empty for the document node
+
+    bool isRoot() const;
+
+    CompactNode previous() const;
+
+    CompactNode next() const;
+
+    std::size_t index() const; // position among the siblings, counts the earlier ones
+
+    bool hasChildren() const;
+
+    CompactNode front() const;
+
+    CompactNode back() const;
+
+    CompactNode at(std::size_t index) const; // walks the siblings
+
+    std::size_t size() const; // number of children, walks them
+
+    CompactNode findFirst(StringRef name) const; // the first descendant element with the name
+
+    std::size_t attributeCount() const;
+
+    StringRef attributeKey(std::size_t n) const;
+
+    StringRef attributeValue(std::size_t n) const;
+
+    bool findAttribute(StringRef key, StringRef &value) const;
+
+private:
+    const CompactDocument *_doc = nullptr;
+    CompactDocument::Index _index = CompactDocument::npos;
+};
+
+
+// nodes reached one from the other, for range-for; the current node must stay linked while iterating
+template<class T>
+class NodeRange {
+public:
+    typedef T *(*Step)(const T *);
+
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T *pointer;
+        typedef T &reference;
+
+        iterator(T *node, Step step) : _node(node), _step(step) {}
+
+        T &operator*() const { return *_node; }
+
+        T *operator->() const { return _node; }
+
+        iterator &operator++() {
+            _node = _step(_node);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator old = *this;
+            _node = _step(_node);
+            return old;
+        }
+
+        bool operator==(const iterator &rhs) const { return _node == rhs._node; }
+
+        bool operator!=(const iterator &rhs) const { return _node != rhs._node; }
+
+    private:
+        T *_node;
+        Step _step;
+    };
 
-class Node {
+    NodeRange(T *first, Step step) : _first(first), _step(step) {}
+
+    iterator begin() const { return iterator(_first, _step); }
+
+    iterator end() const { return iterator(nullptr, _step); }
+
+    bool empty() const { return _first == nullptr; }
+
+private:
+    T *_first;
+    Step _step;
+};
+
+class Node : public std::enable_shared_from_this<Node> {
     friend class Document;
 
     friend class Element;
 
+    friend class Query;
+
+    friend class ElementIndex;
+
+    friend class NodeStore;
+
 public:
     // observer
     std::string getValue() const; // get the tag name of element / text of text / ...
-    const char *getValueC() const; // c_type string as above
+    const char *getValueC() const; // c_type string as above, materializes an in-situ value
+    StringRef getValueRef() const; // the value without copying
     const ElementPtr getParentPtr() const; // return the parent elementary ptr
     ElementPtr getParentPtr();
 
+    ElementHandle parentHandle() const; // nullptr once the node is unlinked
+
     const Element &getParent() const;
 
     Element &getParent();
 
     bool isRoot() const; // whether the node is root node
     NodeType getType() const; // return the type enum value
-    const NodePtr previousPtr() const; // get previous node pointer under same parent
+    const NodePtr previousPtr() const; // get previous node pointer under same parent, nullptr for the first
     NodePtr previousPtr();
 
+    NodeHandle previousHandle() const; // as above without touching reference counts
+
     const Node &previous() const;
 
     Node &previous();
 
-    inline const NodePtr nextPtr() const; // get next node pointer under same parent
-    inline NodePtr nextPtr();
+    const NodePtr nextPtr() const; // get next node pointer under same parent, nullptr for the last
+    NodePtr nextPtr();
+
+    NodeHandle nextHandle() const; // as above without touching reference counts
 
     const Node &next() const;
 
@@ -150,35 +802,47 @@ public:
     virtual bool hasChildren() const = 0; // if the node has a child
     NodePtr getThisPtr();
 
+    NodeRange<Node> siblings() const; // the nodes after this one under the same parent
+    NodeRange<Element> ancestors() const; // parent first, up to the root element
+    NodePtr deepClone() const; // a detached copy of the whole subtree, made in the same store
+
     // modifier
-    inline void setValue(const std::string &txt);
+    void setValue(const std::string &txt);
 
-    inline void setValue(const char *txt);
+    void setValue(const char *txt);
 
     virtual void clear();
 
 protected:
-    std::string _value;
-    std::weak_ptr<Element> _parent;
-    std::size_t _index;
+    mutable std::string _value;
+    mutable StringRef _ref; // set while the value still lives in the Document buffer
+    Element *_parent; // cleared when it lets go of this node
+    std::size_t _index; // position under the parent, renumbered lazily after edits in the middle
+    NodePtr _link; // keeps the node alive while it is linked under a parent
+    Node *_prev = nullptr; // siblings
+    Node *_next = nullptr;
     NodeType _type = NodeType::_node;
+    mutable bool _encoded = false; // _ref is an in-situ text with references, decoded on the first read
+    NodeStore *_store = nullptr; // the arena this node was made in
 
     // constructor
-    Node(ElementPtr parent, std::size_t index, const std::string &value);
+    Node(Element *parent, std::size_t index, const std::string &value);
+
+    Node(Element *parent, std::size_t index);
 
-    Node(ElementPtr parent, std::size_t index);
+    void decode() const; // swap an encoded _ref for its decoded copy in _value
 
-    NodePtr shared_from_this();
+    static Node *nextOf(const Node *node);
 
-    const NodePtr shared_from_this() const;
+    static Element *ancestorOf(const Node *node); // the parent unless it is the Document's
 };
 
 class Nonelement : public Node {
 public:
     // constructor
-    Nonelement(ElementPtr p, std::size_t index);
+    Nonelement(Element *p, std::size_t index);
 
-    Nonelement(ElementPtr p, std::size_t index, const std::string &value);
+    Nonelement(Element *p, std::size_t index, const std::string &value);
 
     // virtual destructor
     // observer
@@ -190,13 +854,23 @@ public:
     friend class Document;
 
     friend class Node;
+
+    friend class Query;
+
+    friend class ElementIndex;
+
+    friend class NodeStore;
+
     // destructor
+    ~Element();
 
     // observer
     bool hasChildren() const override;
 
     const NodePtr frontPtr() const;
 
+    NodeHandle frontHandle() const;
+
     NodePtr frontPtr();
 
     const Node &front() const;
@@ -205,6 +879,8 @@ public:
 
     const NodePtr backPtr() const;
 
+    NodeHandle backHandle() const;
+
     NodePtr backPtr();
 
     const Node &back() const;
@@ -221,13 +897,25 @@ public:
 
     std::size_t findLast(NodePtr ptr);
 
-    Attribute getAttribute(const std::string &key) const; // get attribute with key
+    std::size_t findFirst(NameId name) const; // the first child element with the name
+    std::size_t findFirst(NameId ns, NameId local) const; // and with the namespace, noName for none
+    NameId getNameId() const;
+
+    // resolved from the xmlns declarations in scope when parsed, made, renamed or given an attribute
+    NameId getNamespaceId() const; // the interned URI, noName outside any namespace
+    NameId getLocalNameId() const; // the name without its prefix
+
+    Attribute getAttribute(const std::string &key) const; // get attribute with key, empty when missing
+    const Attribute *findAttribute(StringRef key) const; // nullptr when missing
+    const Attribute *findAttribute(NameId key) const;
     const std::vector<Attribute> &getAllAttributes() const;
 
-    std::vector<Attribute> &getAllAttributes();
+    std::vector<Attribute> &getAllAttributes(); // the caller may edit, drops the lookup order
 
     const NodePtr ptrAt(std::size_t index) const;
 
+    NodeHandle handleAt(std::size_t index) const;
+
     NodePtr ptrAt(std::size_t index);
 
     const Node &at(std::size_t index) const;
@@ -236,10 +924,12 @@ public:
 
     std::size_t size() const;
 
+    NodeRange<Node> children() const;
+
     // modifier
     void addAttribute(const Attribute &attribute);
 
-    void clear() override;
+    void clear() override; // the children and attributes, the name stays so the ids still match it
 
     NodePtr add(NodeType type, const std::string &value);
 
@@ -257,40 +947,97 @@ public:
 
     NodePtr remove(std::size_t index);
 
+    NodePtr insertBefore(NodeHandle next, NodeType type, const std::string &value); // O(1), nullptr next appends
+    NodePtr unlink(NodeHandle child); // O(1), hands the child over to the caller
+    NodePtr insertRange(std::size_t index, const std::vector<std::pair<NodeType, std::string>> &nodes); // returns the first new node
+    void removeRange(std::size_t index, std::size_t count);
+
+    // move a linked or detached subtree here without copying, O(1) when both sides share a NameTable
+    // and the same namespace declarations are in scope, otherwise the subtree is bound again here
+    // so its prefixes mean what they would after a save and load
+    NodePtr moveChild(NodeHandle child); // appends, nullptr when the child is this element or above it
+    NodePtr moveChild(std::size_t index, NodeHandle child);
+
+    NodePtr moveBefore(NodeHandle next, NodeHandle child); // nullptr next appends
+
+    // move the siblings first to last of from, nullptr last for all the rest, returns how many moved
+    std::size_t splice(NodeHandle next, Element &from, NodeHandle first, NodeHandle last);
+
 protected:
+    NodePtr make(NodeType type, std::size_t index, const std::string &value); // new child in the same store
+    void rebind(Node &node); // intern the names of a subtree from another NameTable into this one
+    void noteLinked(Node &child); // tell the index of the tree, if any
+    void noteUnlinking(Node &child);
+    bool encloses(const Node &node) const; // whether node is this element or one of its ancestors
+    void rename(StringRef name); // intern the name and resolve it
+
+    typedef std::vector<std::pair<NameId, NameId>> Scope; // prefix and URI of each declaration, innermost last
+
+    static void openScope(NameTable &names, Scope &scope); // the xml and xmlns prefixes, always bound
+    void declare(Scope &scope) const; // push the xmlns attributes of this element
+    void bind(const Scope &scope); // the namespace and local ids of the name and the attributes
+    void inScope(Scope &scope) const; // the declarations in effect here, those of this element too
+    void resolve(bool subtree = false); // bind against the declarations in scope, the descendants too with subtree
+    void rescope(Scope scope, bool subtree, ElementIndex *index); // scope of the parent, index told of descendants
+    bool sameScope(const Element &from) const; // whether children of from keep their ids when moved here
+    void adopt(Node &child); // bind a child that came from elsewhere against the declarations here
+
+    void linkBefore(Node *next, NodePtr child); // nullptr next appends
+    NodePtr unlinkChild(Node *child);
+    Node *nodeAt(std::size_t index) const; // walks from the nearer end unless the positions are built
+    Node *positionAt(std::size_t index) const; // builds the positions
+    void renumber() const;
+
     // constructor
-    Element(ElementPtr p, std::size_t index);
+    Element(Element *p, std::size_t index);
 
-    Element(ElementPtr p, std::size_t index, const std::string &value);
+    Element(Element *p, std::size_t index, const std::string &value);
 
 private:
-    std::vector<NodePtr> _children;
+    static const std::size_t linearAttributes = 8; // below this a scan beats a binary search
+
+    NameId _nameId = noName;
+    NameId _nsId = noName;
+    NameId _localId = noName;
+    mutable bool _ordered = true; // the _index of every child is right, the flags pack in beside the ids
+    mutable bool _positioned = false; // _positions matches the children
+    mutable bool _attributesDirty = false; // edited through getAllAttributes, ids may be stale
+    mutable bool _declaredDirty = false; // and it declared a namespace before the edit
+    Node *_first = nullptr; // children, each one owns itself through _link while it is here
+    Node *_last = nullptr;
+    std::size_t _size = 0;
+    mutable std::vector<Node *> _positions; // children by position for at(), built on demand
     std::vector<Attribute> _attributes;
+    mutable std::vector<std::uint32_t> _attributeOrder; // positions sorted by key id, built on demand
 };
 
 class Text : public Nonelement {
 public:
     friend class Document;
 
+    friend class NodeStore;
+
     friend class Element;
     // destructor
 
 protected:
     // constructor
-    Text(ElementPtr p, std::size_t index);
+    Text(Element *p, std::size_t index);
 
-    Text(ElementPtr p, std::size_t index, const std::string &value);
+    Text(Element *p, std::size_t index, const std::string &value);
 
 };
 
 class Declaration : public Nonelement {
 public:
     friend class Document;
+
+    friend class NodeStore;
     // destructor
 protected:
-    Declaration(ElementPtr p, std::size_t index);
+    Declaration(Element *p, std::size_t index);
 
-    Declaration(ElementPtr p, std::size_t index, const std::string &value);
+    Declaration(Element *p, std::size_t index, const std::string &value);
 
 };
 
@@ -298,35 +1045,635 @@ class Comment : public Nonelement {
 public:
     friend class Document;
 
+    friend class NodeStore;
+
     friend class Element;
     // destructor
 protected:
-    Comment(ElementPtr p, std::size_t index);
+    Comment(Element *p, std::size_t index);
 
-    Comment(ElementPtr p, std::size_t index, const std::string &value);
+    Comment(Element *p, std::size_t index, const std::string &value);
 };
 
 class Unknown : public Nonelement {
 public:
     friend class Document;
 
+    friend class NodeStore;
+
+    friend class Element;
+    // destructor
+protected:
+    Unknown(Element *p, std::size_t index);
+
+    Unknown(Element *p, std::size_t index, const std::string &value);
+};
+
+class CData : public Nonelement { // <![CDATA[value]]>, the value is never escaped
+public:
+    friend class Document;
+
+    friend class NodeStore;
+
+    friend class Element;
+    // destructor
+protected:
+    CData(Element *p, std::size_t index);
+
+    CData(Element *p, std::size_t index, const std::string &value);
+};
+
+class ProcessingInstruction : public Nonelement { // <?value?>, the target and its data
+public:
+    friend class Document;
+
+    friend class NodeStore;
+
+    friend class Element;
+    // destructor
+protected:
+    ProcessingInstruction(Element *p, std::size_t index);
+
+    ProcessingInstruction(Element *p, std::size_t index, const std::string &value);
+};
+
+class DocType : public Nonelement { // <!DOCTYPE value>, internal subset included
+public:
+    friend class Document;
+
+    friend class NodeStore;
+
     friend class Element;
     // destructor
 protected:
-    Unknown(ElementPtr p, std::size_t index);
+    DocType(Element *p, std::size_t index);
 
-    Unknown(ElementPtr p, std::size_t index, const std::string &value);
+    DocType(Element *p, std::size_t index, const std::string &value);
 };
 
-class Attribute : public std::pair<std::string, std::string> {
+// key and value, either owned or referring into the Document buffer or NodeStore
+class Attribute {
 public:
-    Attribute(const std::string &key, const std::string &value);
+    Attribute(const std::string &key, const std::string &value); // owns a copy
+
+    static Attribute refer(StringRef key, StringRef value, NameId keyId = noName); // nothing is copied
+
+    Attribute(const Attribute &other);
 
+    Attribute &operator=(const Attribute &other);
+
+    // observer
     std::string getKey() const;
 
     std::string getValue() const;
+
+    StringRef getKeyRef() const;
+
+    StringRef getValueRef() const;
+
+    NameId getKeyId() const; // noName unless it belongs to an Element
+    NameId getNamespaceId() const; // noName without a prefix, unless it is an xmlns declaration
+    NameId getLocalNameId() const;
+
+    // modifier
+    void setValue(const std::string &value);
+
+private:
+    friend class Element;
+
+    StringRef _key;
+    StringRef _value;
+    NameId _keyId = noName;
+    NameId _nsId = noName;
+    NameId _localId = noName;
+    bool _owned = false;
+    std::string _storage; // key then value when owned
+
+    Attribute() = default;
+
+    void own(StringRef key, StringRef value);
+};
+
+// lookups by tag and by attribute value on the tree of a Document
+// Element reports its edits here, so the lookups stay current once built
+class ElementIndex {
+public:
+    explicit ElementIndex(Element &top);
+
+    ElementIndex(const ElementIndex &) = delete;
+
+    ElementIndex &operator=(const ElementIndex &) = delete;
+
+    ~ElementIndex();
+
+    static ElementIndex *of(const Node &node); // the index of the tree holding node, nullptr when none
+
+    // observer, valid until the next edit
+    const std::vector<ElementHandle> &elements(NameId tag); // document order
+    const std::vector<ElementHandle> &elements(NameId tag, NameId key, StringRef value);
+    const std::vector<ElementHandle> &elementsIn(NameId ns, NameId local); // noName ns for none
+
+    // edits, while the nodes are linked, subtree for the descendants too
+    void attached(Element &elem, bool subtree);
+    void detaching(Element &elem, bool subtree);
+    void attributesEdited(Element &elem); // through getAllAttributes, the values of its tag are dropped
+    void namespacesEdited(Element &elem); // bound again, the namespace lists of its local name are dropped
+
+private:
+    struct Bucket {
+        std::string value;
+        std::vector<ElementHandle> elements; // document order
+    };
+
+    struct ValueHash {
+        std::size_t operator()(StringRef value) const;
+    };
+
+    typedef std::unordered_map<StringRef, std::unique_ptr<Bucket>, ValueHash> Values; // keys refer into the buckets
+
+    Element &_top;
+    bool _built = false;
+    std::vector<std::vector<ElementHandle>> _byName; // by tag id
+    std::map<std::pair<NameId, NameId>, Values> _byValue; // by tag and key, built on demand
+    std::map<std::pair<NameId, NameId>, std::vector<ElementHandle>> _byNamespace; // by URI and local name, on demand
+    std::unordered_map<NameId, std::unordered_set<const Node *>> _gone; // detached, not yet out of _byName
+
+    void build();
+    std::vector<ElementHandle> &byName(NameId tag); // without the detached ones
+    void add(Element &elem);
+    void remove(Element &elem);
+    static void insert(std::vector<ElementHandle> &list, Element *elem); // at its place in document order
+    static bool before(const Node *a, const Node *b); // document order
+    static std::vector<ElementHandle> &bucket(Values &values, StringRef value); // made when missing
 };
 
+// compiled path over the DOM, a subset of XPath 1.0:
+//   /a/b  //b  ./b  .//b  *  text()  @key (last step only)
+//   {uri}b matches the namespace and local name of an element, {}b an element in no namespace
+//   predicates [2]  [last()]  [@key]  [@key='v']  [@key!='v']  [text()='v'], applied in order
+// a Query holds no Document state, one compiled Query serves any number of Documents
+class Query {
+public:
+    Query() = default;
+
+    explicit Query(const std::string &expression);
+
+    bool compile(const std::string &expression); // false with an error when it is outside the subset
+
+    // evaluate, an absolute path starts from the Document whatever the context
+    std::size_t select(const Document &doc, std::vector<NodeHandle> &out) const; // appends, returns how many
+    std::size_t select(const Element &context, std::vector<NodeHandle> &out) const;
+
+    // the earliest match in document order, nullptr when nothing matches
+    // stops at it unless a // step has steps after it, then every match is found first
+    NodeHandle first(const Document &doc) const;
+    NodeHandle first(const Element &context) const;
+
+    // the text of the matches, or the attribute values when the last step is @key
+    std::size_t values(const Document &doc, std::vector<StringRef> &out) const;
+    std::size_t values(const Element &context, std::vector<StringRef> &out) const;
+
+    bool good() const;
+
+    std::string getError() const;
+
+private:
+    enum class Axis {
+        _child, _descendant, _self, _attribute
+    };
+
+    enum class Test {
+        _name, _expanded, _any, _text
+    };
+
+    struct Predicate {
+        enum class Kind {
+            _position, _last, _has, _equal, _notEqual, _textEqual
+        } kind;
+        std::size_t position; // 1-based for _position
+        std::size_t name; // slot of the attribute name
+        std::string value;
+    };
+
+    struct Step {
+        Axis axis;
+        Test test;
+        std::size_t name; // slot of the element or attribute name, the local name when _expanded
+        std::size_t ns; // slot of the namespace URI when _expanded
+        std::vector<Predicate> predicates;
+    };
+
+    static const std::size_t maxPredicates = 8; // per step, their counters live on the stack
+
+    class Run; // the state of one evaluation
+
+    std::vector<Step> _steps;
+    std::vector<std::string> _names; // by slot, resolved against each NameTable once per evaluation
+    bool _absolute = false;
+    bool _overlapping = false; // a // step may reach the same node from two contexts
+    bool _unordered = false; // steps after a // run from nested contexts, their matches interleave
+    std::string _error;
+
+    std::size_t slot(StringRef name);
+
+    bool fail(const std::string &message);
+};
+
+// replace the predefined and character references, false when there are none to replace
+bool decodeEntities(StringRef in, std::string &out);
+
+// one unit of markup or text, the views point into the tokenizer input
+struct Token {
+    NodeType type = NodeType::_node; // _element is a start tag, _back an end tag
+    StringRef name; // tag name of _element and _back
+    StringRef value; // text, comment body, or everything between < and > otherwise
+    StringRef rawAttributes; // what follows the name in a start tag
+    bool selfClosing = false; // <tag/>
+    bool references = false; // text with a '&' in it, seen by the structural scan at no extra cost
+};
+
+// splits a run of characters into tokens, shared by every parser
+class Tokenizer {
+public:
+    enum class Status {
+        _token, _incomplete, _end, _error
+    };
+
+    // modifier
+    void setInput(const char *begin, const char *end, bool last); // last: no more data will follow
+    void resume(const char *begin, const char *end, bool last); // more of the same input, begin is what position() was
+    Status next(Token &token);
+
+    // observer
+    const char *position() const; // first character not yet consumed
+    std::string getError() const;
+
+    // structural characters < > & " ' of a 64 byte aligned block as a bit mask, SSE2/AVX2 when available
+    static std::uint64_t structuralMask(const char *block, const char *begin, const char *end);
+
+private:
+    const char *_begin = nullptr;
+    const char *_pos = nullptr;
+    const char *_end = nullptr;
+    bool _last = true;
+    std::string _error;
+
+    // structural index of the block being scanned
+    const char *_block = nullptr;
+    std::uint64_t _mask = 0;
+
+    // how far the unfinished token at _pos was scanned, so more input does not scan it again
+    std::size_t _scanned = 0;
+    char _quote = 0; // open quote of an unfinished start tag
+    bool _references = false; // an unfinished text had a '&'
+
+    const char *nextStructural(const char *from); // _end when there is none
+    Status markup(Token &token);
+    Status doctype(Token &token);
+    Status until(const char *terminator, std::size_t length, const char *from, const char *&found);
+    Status incomplete(const char *scanned, char quote); // remember where to go on
+    Status fail(const std::string &message);
+};
+
+// pull parser, a cursor moving from node to node with memory bounded by depth and token size
+class Reader {
+public:
+    Reader() = default;
+
+    Reader(const Reader &) = delete;
+
+    Reader &operator=(const Reader &) = delete;
+
+    // io
+    bool open(std::istream &is); // read block by block, the stream must outlive the reader
+    bool open(const char *data, std::size_t size); // the data must outlive the reader
+    bool openFile(const std::string &fileName); // map the file
+    void replay(const Token *begin, const Token *end, bool last); // tokens made elsewhere, more may follow
+    bool openPush(); // the input comes by feed
+    bool feed(const char *data, std::size_t size, bool last); // the data must stay until next waits again
+    void setWhitespace(Whitespace policy); // _drop unless set, kept by open
+
+    // modifier
+    bool next(); // move to the next node, false at the end or on error
+    bool skipSubtree(); // on a start tag move to its end tag, nothing inside is reported
+
+    // observer, the views are valid until the next move
+    NodeType nodeType() const; // _element for a start tag, _back for an end tag
+    StringRef name() const; // tag name of a start or end tag
+    StringRef value() const; // text with its references decoded, comment body, or the whole tag otherwise
+    StringRef rawValue() const; // as value, a text as it is in the input
+    bool hasReferences() const; // a text with references in it, value decodes them
+    const std::vector<Attribute> &attributes() const;
+
+    bool isEmptyElement() const; // <tag/>, no end tag follows
+    std::size_t depth() const; // number of enclosing elements
+    bool waiting() const; // next stopped at the end of the fed data, feed more and go on
+    Whitespace whitespace() const;
+    bool good() const; // no error so far
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    static const std::size_t blockSize = 64 * 1024;
+    static const std::size_t pushStep = 256; // chunk bytes copied behind an unfinished token at a time
+
+    Tokenizer _tokenizer;
+    Token _token;
+    std::size_t _depth = 0;
+    std::string _error;
+
+    // input
+    bool _replaying = false;
+    const Token *_replay = nullptr;
+    const Token *_replayEnd = nullptr;
+    std::istream *_is = nullptr;
+    std::vector<char> _window;
+    std::size_t _filled = 0;
+    bool _last = true;
+    std::shared_ptr<MappedFile> _file;
+    bool _pushing = false;
+    bool _waiting = false;
+    bool _inWindow = true; // the tokenizer is in the window, not in the fed chunk
+    const char *_chunk = nullptr; // what is left of the fed chunk
+    const char *_chunkEnd = nullptr;
+    std::size_t _appended = 0; // the window ends with this many bytes copied from before _chunk
+
+    // state
+    std::string _names; // names of the open elements, back to back
+    std::vector<std::size_t> _nameStarts;
+    std::vector<Attribute> _attributes;
+    std::deque<std::string> _decoded; // values with references, one per attribute slot, never moved
+    Whitespace _whitespace = Whitespace::_drop;
+    mutable std::string _text; // the current text decoded or normalized, filled by the first value()
+    mutable StringRef _textValue;
+    mutable bool _textDecoded = false;
+    bool _started = false; // anything seen yet
+    bool _rootDone = false;
+    bool _done = false;
+    bool _skipping = false; // inside skipSubtree, attributes are not split
+
+    void begin();
+    bool refill(); // keep the unfinished token and read more
+    bool pull(); // go on in the fed chunk, false when it is used up
+    bool accept(); // check the current token against the open elements
+    bool parseAttributes(); // split the attributes of a start tag
+    bool finish();
+    bool fail(const std::string &message);
+};
+
+// callbacks of the streaming parser, return false to stop parsing
+class SaxHandler {
+public:
+    virtual ~SaxHandler() = default;
+
+    virtual bool declaration(StringRef value);
+
+    virtual bool startElement(StringRef name, const std::vector<Attribute> &attributes);
+
+    virtual bool endElement(StringRef name); // also sent for <tag/>
+
+    virtual bool text(StringRef value); // references decoded
+
+    virtual bool encodedText(StringRef value); // a text with references as it is in the input, decodes and calls text
+
+    virtual bool comment(StringRef value);
+
+    virtual bool unknown(StringRef value);
+
+    virtual bool cdata(StringRef value); // the body of <![CDATA[ ]]>, calls text by default
+
+    virtual bool processingInstruction(StringRef value); // target and data of <? ?>
+
+    virtual bool doctype(StringRef value); // what follows <!DOCTYPE
+};
+
+// streaming event parser, pushes what a Reader pulls to a SaxHandler
+class SaxParser {
+public:
+    explicit SaxParser(SaxHandler &handler);
+
+    // io
+    bool parse(std::istream &is); // read block by block
+    bool parse(const char *data, std::size_t size); // the whole input is in memory
+    bool parseParallel(const char *data, std::size_t size, unsigned threads); // tokenize ahead on threads
+    bool parseFile(const std::string &fileName); // map the file and parse it
+    bool parse(Reader &reader); // push what the reader yields until it stops
+
+    // modifier
+    void setWhitespace(Whitespace policy); // for the readers parse opens itself
+
+    // observer
+    bool stopped() const; // the handler asked to stop
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    static const std::size_t parallelChunk = 4 * 1024 * 1024; // bytes tokenized by one task
+    static const std::size_t parallelRetries = 8; // chunks tokenized again before the rest goes serially
+
+    SaxHandler &_handler;
+    std::string _error;
+    bool _stopped = false; // the handler asked to stop
+    Whitespace _whitespace = Whitespace::_drop;
+};
+
+// streaming event parser fed chunk by chunk as the data arrives, e.g. from a socket
+// a tag, comment or attribute value may be split anywhere, the unfinished part is kept until it ends
+class PushParser {
+public:
+    explicit PushParser(SaxHandler &handler);
+
+    PushParser(const PushParser &) = delete;
+
+    PushParser &operator=(const PushParser &) = delete;
+
+    // io
+    bool feed(const char *data, std::size_t size); // push every node the data completes, false on error or stop
+    bool finish(); // the input is complete, false on an error such as an unclosed tag
+    void restart(); // a new document from the next feed
+    void setWhitespace(Whitespace policy);
+
+    // observer
+    bool good() const; // no error so far
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    Reader _reader;
+    SaxParser _parser;
+    std::string _error;
+    bool _done = false; // finished, failed or stopped by the handler
+
+    bool run(); // push what the reader has
+};
+
+// receives what a PathFilter extracts, return false to stop
+class PathHandler {
+public:
+    virtual ~PathHandler() = default;
+
+    virtual bool match(std::size_t path, StringRef value) = 0; // path is the id add returned
+};
+
+// extracts the values at a set of paths while the input streams by, no tree is built
+//   /a/b  //b  /a/*/c  /a/b/text()  and a last step @key for an attribute value
+// the text of a matched element comes piece by piece, one call per text directly inside it
+// every path runs in one automaton built on demand, subtrees no path can enter are skipped
+class PathFilter {
+public:
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit PathFilter(PathHandler &handler);
+
+    PathFilter(const PathFilter &) = delete;
+
+    PathFilter &operator=(const PathFilter &) = delete;
+
+    // modifier
+    std::size_t add(const std::string &path); // the id passed to match, npos with an error when unsupported
+
+    // io
+    bool parse(std::istream &is);
+    bool parse(const char *data, std::size_t size);
+    bool parseFile(const std::string &fileName);
+    bool parse(Reader &reader); // until the reader or the handler stops
+
+    // observer
+    std::size_t size() const; // paths added
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    static const std::uint32_t unknown = 0xFFFFFFFFu; // a transition not built yet
+    static const std::uint32_t dead = 0; // the state without paths, its subtree is skipped
+    static const std::uint32_t top = 1; // the state outside the root element
+
+    struct Edge {
+        NameId name; // noName for *
+        bool descendant; // //name
+        std::size_t target;
+    };
+
+    // the paths as a trie of steps, shared prefixes share nodes
+    struct Step {
+        std::vector<Edge> edges;
+        bool loops = false; // an edge is a // step, those edges stay active below the node
+        std::vector<std::size_t> texts; // paths ending here
+        std::vector<std::pair<std::size_t, std::string>> attributes; // paths ending here in @key
+    };
+
+    // a set of trie nodes active together
+    struct State {
+        std::vector<std::size_t> steps; // node * 2, + 1 when only below it, where just its // edges apply
+        std::vector<std::uint32_t> next; // by name id, the last one for names no path has
+        std::vector<std::size_t> texts;
+        std::vector<std::pair<std::size_t, StringRef>> attributes;
+    };
+
+    PathHandler &_handler;
+    NameTable _names; // only the names in the paths
+    std::vector<Step> _trie;
+    std::size_t _paths = 0;
+    std::vector<State> _states; // built lazily, reset by add
+    std::map<std::vector<std::size_t>, std::uint32_t> _known;
+    std::vector<std::uint32_t> _stack; // the state of each open element
+    std::string _error;
+
+    std::uint32_t state(std::vector<std::size_t> &steps); // sorts steps, finds or makes the state
+    std::uint32_t move(std::uint32_t from, StringRef name);
+};
+
+// streaming writer, lays the output out like Document::save without building a tree
+// an element's children go without layout from its first text or CDATA child on, like save
+// as the output streams, layout already written before that text stays
+class XmlWriter {
+public:
+    explicit XmlWriter(int fd, const SaveOptions &options = SaveOptions());
+
+    explicit XmlWriter(std::ostream &os, const SaveOptions &options = SaveOptions());
+
+    explicit XmlWriter(std::string &out, const SaveOptions &options = SaveOptions()); // append to out
+
+    // io, every call returns false once the output is not well-formed
+    bool declaration(StringRef value = "?xml version=\"1.0\"?"); // written as <value>
+    bool startElement(StringRef name);
+    bool attribute(StringRef key, StringRef value); // only right after startElement
+    bool text(StringRef value); // escaped
+    bool comment(StringRef value);
+    bool unknown(StringRef value); // written as <value>
+    bool cdata(StringRef value); // written as it is in a CDATA section
+    bool processingInstruction(StringRef value); // target and data, written as <?value?>
+    bool doctype(StringRef value); // written as <!DOCTYPE value>, only before the root element
+    bool endElement();
+    bool endElement(StringRef name); // also checks the name of the element it closes
+    bool finish(); // check that everything is closed and flush
+
+    // observer
+    std::size_t depth() const;
+
+    bool good() const;
+
+    std::string getError() const;
+
+    const char *getErrorC() const;
+
+private:
+    OutputBuffer _out;
+    bool _pretty; // off while inside an element that holds text
+    unsigned _indent;
+    std::size_t _flat = 0; // depth of the element whose text turned the layout off, 0 for none
+    std::string _spaces; // the deepest indent so far, shallower ones are prefixes
+    std::string _names; // names of the open elements back to back
+    std::vector<std::size_t> _nameStarts;
+    bool _tagOpen = false; // the start tag still takes attributes
+    bool _broken = false; // the innermost element has its children on lines of their own
+    NodeType _heldType = NodeType::_node; // a first text or comment, laid out once the next event shows if it is alone
+    std::string _held;
+    bool _started = false; // anything but the declaration was written
+    bool _rootDone = false;
+    std::string _error;
+
+    bool nonelement(NodeType type, StringRef value);
+    bool child(bool element); // lay out what a new child of the innermost element makes known
+    void putHeld();
+    void putNonelement(NodeType type, StringRef value);
+    void newline();
+    void indent(std::size_t depth);
+    bool fail(const std::string &message);
+};
+
+}
+
+// template implementation
+namespace Xsea {
+
+template<class T>
+std::shared_ptr<T> NodeStore::adopt(const NodeStorePtr &store, T *node) {
+    node->_store = store.get();
+    NodeStore *raw = store.get();
+    return std::shared_ptr<T>(node, [raw](T *p) {
+        p->~T();
+        raw->deallocate(p, sizeof(T));
+    }, Allocator<T>(store));
+}
+
+template<class T>
+std::shared_ptr<T> NodeStore::make(const NodeStorePtr &store, Element *parent, std::size_t index) {
+    void *mem = store->allocate(sizeof(T));
+    return adopt(store, ::new(mem) T(parent, index));
+}
+
+template<class T>
+std::shared_ptr<T> NodeStore::make(const NodeStorePtr &store, Element *parent, std::size_t index,
+                                   const std::string &value) {
+    void *mem = store->allocate(sizeof(T));
+    return adopt(store, ::new(mem) T(parent, index, value));
+}
+
 }
 
 #endif //XSEA_XSEA_H
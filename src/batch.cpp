@@ -0,0 +1,139 @@
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include "../include/xsea.h"
+
+Xsea::DocumentBatch::DocumentBatch(unsigned threads) : _threads(threads) {
+    if (_threads == 0)
+        _threads = std::thread::hardware_concurrency();
+    if (_threads == 0)
+        _threads = 1;
+}
+
+Xsea::DocumentBatch Xsea::DocumentBatch::loadMany(const std::vector<std::string> &fileNames, unsigned threads) {
+    DocumentBatch batch(threads);
+    for (const std::string &fileName : fileNames)
+        batch.addFile(fileName);
+    batch.load();
+    return batch;
+}
+
+void Xsea::DocumentBatch::addFile(const std::string &fileName) {
+    _inputs.emplace_back();
+    _inputs.back().fileName = fileName;
+    _inputs.back().isFile = true;
+}
+
+void Xsea::DocumentBatch::addBuffer(const char *data, std::size_t size) {
+    _inputs.emplace_back();
+    _inputs.back().data = data;
+    _inputs.back().size = size;
+}
+
+void Xsea::DocumentBatch::addBuffer(std::string &&buffer) {
+    _inputs.emplace_back();
+    _inputs.back().buffer = std::move(buffer);
+    _inputs.back().owned = true;
+}
+
+bool Xsea::DocumentBatch::loadOne(Input &input, Document &doc) {
+    if (input.owned)
+        return doc.loadBuffer(std::move(input.buffer));
+    if (!input.isFile) // borrowed data is copied once, like Document::loadBuffer
+        return doc.loadBuffer(input.data, input.size);
+    // read small files in one go, mapping them costs more than copying and serializes on the address space
+    doc._filename = input.fileName;
+    std::ifstream is(input.fileName, std::ios::binary);
+    if (!is.is_open()) {
+        doc._error += "Cannot open file " + input.fileName + "\n";
+        return false;
+    }
+    is.seekg(0, std::ios::end);
+    std::streamoff size = is.tellg(); // -1 for a pipe, anything at all for a directory
+    is.clear();
+    is.seekg(0);
+    is.clear();
+    std::string buffer;
+    bool read = true;
+    if (is.peek() == std::char_traits<char>::eof()) { // a directory opens but has nothing to read
+        read = size == 0;
+    } else if (size > 0) { // trusted once a byte could be read
+        buffer.resize(static_cast<std::size_t>(size));
+        read = static_cast<bool>(is.read(&buffer[0], static_cast<std::streamsize>(buffer.size())));
+    } else {
+        buffer.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    }
+    if (!read) {
+        doc._error += "Cannot read file " + input.fileName + "\n";
+        return false;
+    }
+    return doc.loadBuffer(std::move(buffer));
+}
+
+bool Xsea::DocumentBatch::load() {
+    std::size_t first = _documents.size();
+    for (std::size_t i = first; i < _inputs.size(); i++)
+        _documents.emplace_back(new Document());
+
+    // inputs are claimed one at a time, so a thread stuck on a big one does not hold back the rest
+    std::atomic<std::size_t> next(first);
+    auto work = [&]() {
+        ParseOptions options;
+        options.threads = 1; // the batch already keeps every core busy
+        while (true) {
+            std::size_t i = next++;
+            if (i >= _inputs.size())
+                return;
+            Document &doc = *_documents[i];
+            doc.setParseOptions(options);
+            try { // nothing may leave the thread, one bad input must not end the process
+                _inputs[i].ok = loadOne(_inputs[i], doc);
+            } catch (const std::exception &e) {
+                doc._error += "Cannot load input " + std::to_string(i) + ": " + e.what() + "\n";
+                _inputs[i].ok = false;
+            }
+            _inputs[i].done = true;
+        }
+    };
+    std::size_t pending = _inputs.size() - first;
+    std::size_t threads = _threads < pending ? _threads : pending;
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < threads; t++)
+        workers.emplace_back(work);
+    work();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    bool ok = true;
+    for (std::size_t i = first; i < _inputs.size(); i++)
+        ok = ok && _inputs[i].ok;
+    return ok;
+}
+
+std::size_t Xsea::DocumentBatch::size() const {
+    return _documents.size();
+}
+
+Xsea::Document &Xsea::DocumentBatch::getDocument(std::size_t i) {
+    return *_documents.at(i);
+}
+
+const Xsea::Document &Xsea::DocumentBatch::getDocument(std::size_t i) const {
+    return *_documents.at(i);
+}
+
+bool Xsea::DocumentBatch::good(std::size_t i) const {
+    return _inputs.at(i).done && _inputs.at(i).ok;
+}
+
+std::string Xsea::DocumentBatch::getError(std::size_t i) const {
+    return _documents.at(i)->getError();
+}
+
+std::vector<std::size_t> Xsea::DocumentBatch::getFailed() const {
+    std::vector<std::size_t> failed;
+    for (std::size_t i = 0; i < _documents.size(); i++)
+        if (!good(i))
+            failed.push_back(i);
+    return failed;
+}
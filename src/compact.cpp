@@ -0,0 +1,492 @@
+#include "../include/xsea.h"
+
+namespace {
+
+const char magic[8] = {'X', 'S', 'E', 'A', 'B', 'I', 'N', '\0'};
+const std::uint32_t byteOrder = 0x01020304u;
+
+std::uint64_t align(std::uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::size_t total) {
+    return offset % 8 == 0 && offset <= total && count <= (total - offset) / size;
+}
+
+}
+
+class Xsea::Document::SnapshotWriter {
+public:
+    typedef CompactDocument::Index Index;
+
+    explicit SnapshotWriter(const Document &doc) {
+        Index top = node(NodeType::_node, CompactDocument::npos, StringRef());
+        Index prev = CompactDocument::npos;
+        if (doc._declarationPtr != nullptr)
+            prev = link(top, prev, node(NodeType::_declaration, top, doc._declarationPtr->getValueRef()));
+        for (const Node &child : doc._root->children())
+            prev = link(top, prev, add(child, top));
+    }
+
+    void write(OutputBuffer &out) {
+        std::vector<CompactDocument::NameRecord> names(_names.size());
+        for (NameId id = 0; id < _names.size(); id++) {
+            StringRef name = _names.name(id);
+            names[id] = CompactDocument::NameRecord{string(name), static_cast<std::uint32_t>(name.size()), 0};
+        }
+
+        CompactDocument::Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = CompactDocument::version;
+        header.byteOrder = byteOrder;
+        header.nodeCount = static_cast<std::uint32_t>(_nodes.size());
+        header.attributeCount = static_cast<std::uint32_t>(_attributes.size());
+        header.nameCount = static_cast<std::uint32_t>(_names.size());
+        header.nodes = align(sizeof(header));
+        header.attributes = align(header.nodes + _nodes.size() * sizeof(CompactDocument::NodeRecord));
+        header.names = align(header.attributes + _attributes.size() * sizeof(CompactDocument::AttributeRecord));
+        header.strings = align(header.names + _names.size() * sizeof(CompactDocument::NameRecord));
+        header.stringsSize = _strings.size();
+
+        std::uint64_t at = 0;
+        section(out, at, 0, &header, sizeof(header));
+        section(out, at, header.nodes, _nodes.data(), _nodes.size() * sizeof(CompactDocument::NodeRecord));
+        section(out, at, header.attributes, _attributes.data(),
+                _attributes.size() * sizeof(CompactDocument::AttributeRecord));
+        section(out, at, header.names, names.data(), names.size() * sizeof(CompactDocument::NameRecord));
+        section(out, at, header.strings, _strings.data(), _strings.size());
+    }
+
+private:
+    std::vector<CompactDocument::NodeRecord> _nodes;
+    std::vector<CompactDocument::AttributeRecord> _attributes;
+    NameTable _names; // the snapshot numbers its names on its own
+    std::string _strings;
+
+    Index add(const Node &ptr, Index parent) {
+        if (ptr._type != NodeType::_element)
+            return node(ptr._type, parent, ptr.getValueRef());
+        auto &elem = static_cast<const Element &>(ptr);
+        Index i = node(NodeType::_element, parent, StringRef());
+        _nodes[i].name = _names.intern(elem.getValueRef());
+        _nodes[i].firstAttribute = static_cast<std::uint32_t>(_attributes.size());
+        _nodes[i].attributeCount = static_cast<std::uint32_t>(elem._attributes.size());
+        for (const Attribute &attr : elem._attributes) {
+            StringRef value = attr.getValueRef();
+            _attributes.push_back(CompactDocument::AttributeRecord{
+                    _names.intern(attr.getKeyRef()), static_cast<std::uint32_t>(value.size()), string(value)});
+        }
+        Index prev = CompactDocument::npos;
+        for (const Node &child : elem.children())
+            prev = link(i, prev, add(child, i));
+        return i;
+    }
+
+    Index node(NodeType type, Index parent, StringRef value) {
+        CompactDocument::NodeRecord record{};
+        record.type = static_cast<std::uint32_t>(type);
+        record.name = CompactDocument::npos;
+        record.parent = parent;
+        record.firstChild = CompactDocument::npos;
+        record.lastChild = CompactDocument::npos;
+        record.previousSibling = CompactDocument::npos;
+        record.nextSibling = CompactDocument::npos;
+        record.valueSize = static_cast<std::uint32_t>(value.size());
+        record.value = string(value);
+        _nodes.push_back(record);
+        return static_cast<Index>(_nodes.size() - 1);
+    }
+
+    Index link(Index parent, Index prev, Index i) { // append i to the children of parent
+        if (prev == CompactDocument::npos)
+            _nodes[parent].firstChild = i;
+        else
+            _nodes[prev].nextSibling = i;
+        _nodes[i].previousSibling = prev;
+        _nodes[parent].lastChild = i;
+        return i;
+    }
+
+    std::uint64_t string(StringRef str) {
+        std::uint64_t offset = _strings.size();
+        _strings.append(str.data(), str.size());
+        _strings.push_back('\0');
+        return offset;
+    }
+
+    static void section(OutputBuffer &out, std::uint64_t &at, std::uint64_t offset, const void *data, std::size_t size) {
+        static const char zeros[8] = {};
+        out.put(zeros, static_cast<std::size_t>(offset - at));
+        out.put(static_cast<const char *>(data), size);
+        at = offset + size;
+    }
+};
+
+bool Xsea::Document::saveBinary(const std::string &fileName) const {
+    std::ofstream os(fileName, std::ios::binary);
+    if (!os.is_open())
+        return false;
+    OutputBuffer out(os);
+    SnapshotWriter(*this).write(out);
+    return out.flush();
+}
+
+void Xsea::Document::saveBinary(std::string &out) const {
+    OutputBuffer buffer(out);
+    SnapshotWriter(*this).write(buffer);
+}
+
+bool Xsea::Document::loadBinary(const std::string &fileName) {
+    CompactDocument snapshot;
+    if (!snapshot.mapFile(fileName)) {
+        _error += snapshot.getError();
+        return false;
+    }
+    _filename = fileName;
+    reset();
+    _store->retain(snapshot._input); // values refer into the mapping
+    NameTable &names = _store->names();
+    std::vector<NameId> ids(snapshot._header->nameCount);
+    for (std::uint32_t n = 0; n < ids.size(); n++)
+        ids[n] = names.intern(snapshot.string(snapshot._names[n].offset, snapshot._names[n].size));
+
+    // walk in document order, the parent of each node was created before it
+    std::vector<ElementPtr> open; // the current node's element ancestors
+    std::vector<CompactDocument::Index> openIndex;
+    open.push_back(_root);
+    openIndex.push_back(0);
+    Element::Scope scope; // the namespace declarations in force, marks holds its size below each open element
+    std::vector<std::size_t> marks;
+    Element::openScope(names, scope);
+    for (CompactDocument::Index i = 1; i < snapshot.size(); i++) {
+        const CompactDocument::NodeRecord &record = snapshot._nodes[i];
+        while (openIndex.size() > 1 && openIndex.back() != record.parent) {
+            open.pop_back();
+            openIndex.pop_back();
+            scope.resize(marks.back());
+            marks.pop_back();
+        }
+        if (openIndex.back() != record.parent) {
+            _error += "Snapshot nodes are not in document order\n";
+            reset();
+            return false;
+        }
+        ElementPtr &parent = open.back();
+        StringRef value = snapshot.value(i);
+        switch (static_cast<NodeType>(record.type)) {
+            case NodeType::_declaration:
+                _declarationPtr = NodeStore::make<Declaration>(_store, nullptr, 0);
+                _declarationPtr->_ref = value;
+                break;
+            case NodeType::_element: {
+                if (record.name >= ids.size()) {
+                    _error += "Snapshot element without a name\n";
+                    reset();
+                    return false;
+                }
+                ElementPtr elemPtr = NodeStore::make<Element>(_store, parent.get(), parent->_size);
+                elemPtr->_nameId = ids[record.name];
+                elemPtr->_ref = names.name(elemPtr->_nameId);
+                elemPtr->_attributes.reserve(record.attributeCount);
+                for (std::size_t n = 0; n < snapshot.attributeCount(i); n++) {
+                    std::uint32_t key = snapshot._attributes[record.firstAttribute + n].name;
+                    NameId id = key < ids.size() ? ids[key] : names.intern("");
+                    elemPtr->_attributes.push_back(Attribute::refer(names.name(id), snapshot.attributeValue(i, n), id));
+                }
+                marks.push_back(scope.size());
+                elemPtr->declare(scope);
+                elemPtr->bind(scope);
+                parent->linkBefore(nullptr, elemPtr);
+                open.push_back(std::move(elemPtr));
+                openIndex.push_back(i);
+                break;
+            }
+            case NodeType::_text:
+                parent->linkBefore(nullptr, NodeStore::make<Text>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            case NodeType::_comment:
+                parent->linkBefore(nullptr, NodeStore::make<Comment>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            case NodeType::_unknown:
+                parent->linkBefore(nullptr, NodeStore::make<Unknown>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            case NodeType::_cdata:
+                parent->linkBefore(nullptr, NodeStore::make<CData>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            case NodeType::_instruction:
+                parent->linkBefore(nullptr, NodeStore::make<ProcessingInstruction>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            case NodeType::_doctype:
+                parent->linkBefore(nullptr, NodeStore::make<DocType>(_store, parent.get(), parent->_size));
+                parent->_last->_ref = value;
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+bool Xsea::CompactDocument::mapFile(const std::string &fileName) {
+    auto file = std::make_shared<MappedFile>(fileName);
+    if (!file->isOpen())
+        return fail("Cannot open file " + fileName + "\n");
+    _input = file;
+    return open(file->data(), file->size());
+}
+
+bool Xsea::CompactDocument::loadBuffer(std::string &&buffer) {
+    auto input = std::make_shared<std::string>(std::move(buffer));
+    _input = input;
+    return open(input->data(), input->size());
+}
+
+bool Xsea::CompactDocument::loadDocument(const Document &doc) {
+    std::string buffer;
+    doc.saveBinary(buffer);
+    return loadBuffer(std::move(buffer));
+}
+
+bool Xsea::CompactDocument::open(const char *data, std::size_t size) {
+    _error.clear();
+    _data = data;
+    _size = size;
+    _header = nullptr;
+    auto header = reinterpret_cast<const Header *>(data);
+    if (size < sizeof(Header) || std::memcmp(header->magic, magic, sizeof(magic)) != 0)
+        return fail("Not a snapshot\n");
+    if (header->byteOrder != byteOrder)
+        return fail("Snapshot written with another byte order\n");
+    if (header->version != version)
+        return fail("Snapshot version " + std::to_string(header->version) + " is not supported\n");
+    if (header->nodeCount == 0 || !fits(header->nodes, header->nodeCount, sizeof(NodeRecord), size)
+        || !fits(header->attributes, header->attributeCount, sizeof(AttributeRecord), size)
+        || !fits(header->names, header->nameCount, sizeof(NameRecord), size)
+        || header->strings > size || header->stringsSize > size - header->strings)
+        return fail("Snapshot is truncated\n");
+    _header = header;
+    _nodes = reinterpret_cast<const NodeRecord *>(data + header->nodes);
+    _attributes = reinterpret_cast<const AttributeRecord *>(data + header->attributes);
+    _names = reinterpret_cast<const NameRecord *>(data + header->names);
+    _strings = data + header->strings;
+    return true;
+}
+
+std::size_t Xsea::CompactDocument::size() const {
+    return _header == nullptr ? 0 : _header->nodeCount;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::root() const {
+    if (_header == nullptr)
+        return npos;
+    for (Index i = firstChild(0); i != npos; i = nextSibling(i))
+        if (type(i) == NodeType::_element)
+            return i;
+    return npos;
+}
+
+Xsea::CompactNode Xsea::CompactDocument::getRoot() const {
+    return CompactNode(this, root());
+}
+
+Xsea::CompactNode Xsea::CompactDocument::node(Index i) const {
+    return CompactNode(this, i < size() ? i : npos);
+}
+
+Xsea::NodeType Xsea::CompactDocument::type(Index i) const {
+    return static_cast<NodeType>(_nodes[i].type);
+}
+
+Xsea::StringRef Xsea::CompactDocument::name(Index i) const {
+    std::uint32_t n = _nodes[i].name;
+    if (n >= _header->nameCount)
+        return StringRef();
+    return string(_names[n].offset, _names[n].size);
+}
+
+Xsea::StringRef Xsea::CompactDocument::value(Index i) const {
+    if (type(i) == NodeType::_element)
+        return name(i);
+    return string(_nodes[i].value, _nodes[i].valueSize);
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::parent(Index i) const {
+    Index p = _nodes[i].parent;
+    return p < _header->nodeCount ? p : npos;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::firstChild(Index i) const {
+    Index c = _nodes[i].firstChild;
+    return c < _header->nodeCount ? c : npos;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::lastChild(Index i) const {
+    Index c = _nodes[i].lastChild;
+    return c < _header->nodeCount ? c : npos;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::previousSibling(Index i) const {
+    Index s = _nodes[i].previousSibling;
+    return s < _header->nodeCount ? s : npos;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::nextSibling(Index i) const {
+    Index s = _nodes[i].nextSibling;
+    return s < _header->nodeCount ? s : npos;
+}
+
+std::size_t Xsea::CompactDocument::attributeCount(Index i) const {
+    const NodeRecord &record = _nodes[i];
+    if (record.firstAttribute > _header->attributeCount
+        || record.attributeCount > _header->attributeCount - record.firstAttribute)
+        return 0;
+    return record.attributeCount;
+}
+
+Xsea::StringRef Xsea::CompactDocument::attributeKey(Index i, std::size_t n) const {
+    std::uint32_t key = _attributes[_nodes[i].firstAttribute + n].name;
+    if (key >= _header->nameCount)
+        return StringRef();
+    return string(_names[key].offset, _names[key].size);
+}
+
+Xsea::StringRef Xsea::CompactDocument::attributeValue(Index i, std::size_t n) const {
+    const AttributeRecord &attr = _attributes[_nodes[i].firstAttribute + n];
+    return string(attr.value, attr.valueSize);
+}
+
+bool Xsea::CompactDocument::findAttribute(Index i, StringRef key, StringRef &value) const {
+    for (std::size_t n = 0; n < attributeCount(i); n++) {
+        if (attributeKey(i, n) == key) {
+            value = attributeValue(i, n);
+            return true;
+        }
+    }
+    return false;
+}
+
+Xsea::CompactDocument::Index Xsea::CompactDocument::findFirst(Index i, StringRef name) const {
+    std::uint32_t id = npos;
+    for (std::uint32_t n = 0; n < _header->nameCount && id == npos; n++)
+        if (string(_names[n].offset, _names[n].size) == name)
+            id = n;
+    if (id == npos)
+        return npos;
+    Index end = i; // the descendants of i come right after it in document order
+    while (end != npos && nextSibling(end) == npos)
+        end = parent(end);
+    end = end == npos ? static_cast<Index>(size()) : nextSibling(end);
+    for (Index d = i + 1; d < end; d++)
+        if (_nodes[d].name == id && type(d) == NodeType::_element)
+            return d;
+    return npos;
+}
+
+std::string Xsea::CompactDocument::getError() const {
+    return _error;
+}
+
+const char *Xsea::CompactDocument::getErrorC() const {
+    return _error.c_str();
+}
+
+Xsea::StringRef Xsea::CompactDocument::string(std::uint64_t offset, std::uint32_t size) const {
+    if (offset > _header->stringsSize || size > _header->stringsSize - offset)
+        return StringRef("", 0);
+    return StringRef(_strings + offset, size);
+}
+
+bool Xsea::CompactDocument::fail(const std::string &message) {
+    _error += message;
+    return false;
+}
+
+Xsea::NodeType Xsea::CompactNode::getType() const {
+    return _doc->type(_index);
+}
+
+std::string Xsea::CompactNode::getValue() const {
+    return _doc->value(_index).str();
+}
+
+const char *Xsea::CompactNode::getValueC() const {
+    return _doc->value(_index).data();
+}
+
+Xsea::StringRef Xsea::CompactNode::getValueRef() const {
+    return _doc->value(_index);
+}
+
+Xsea::CompactNode Xsea::CompactNode::getParent() const {
+    return CompactNode(_doc, _doc->parent(_index));
+}
+
+bool Xsea::CompactNode::isRoot() const {
+    return _index == _doc->root();
+}
+
+Xsea::CompactNode Xsea::CompactNode::previous() const {
+    return CompactNode(_doc, _doc->previousSibling(_index));
+}
+
+Xsea::CompactNode Xsea::CompactNode::next() const {
+    return CompactNode(_doc, _doc->nextSibling(_index));
+}
+
+std::size_t Xsea::CompactNode::index() const {
+    std::size_t n = 0;
+    for (CompactDocument::Index i = _doc->previousSibling(_index); i != CompactDocument::npos; i = _doc->previousSibling(i))
+        n++;
+    return n;
+}
+
+bool Xsea::CompactNode::hasChildren() const {
+    return _doc->firstChild(_index) != CompactDocument::npos;
+}
+
+Xsea::CompactNode Xsea::CompactNode::front() const {
+    return CompactNode(_doc, _doc->firstChild(_index));
+}
+
+Xsea::CompactNode Xsea::CompactNode::back() const {
+    return CompactNode(_doc, _doc->lastChild(_index));
+}
+
+Xsea::CompactNode Xsea::CompactNode::at(std::size_t index) const {
+    CompactDocument::Index i = _doc->firstChild(_index);
+    for (; i != CompactDocument::npos && index > 0; index--)
+        i = _doc->nextSibling(i);
+    return CompactNode(_doc, i);
+}
+
+std::size_t Xsea::CompactNode::size() const {
+    std::size_t n = 0;
+    for (CompactDocument::Index i = _doc->firstChild(_index); i != CompactDocument::npos; i = _doc->nextSibling(i))
+        n++;
+    return n;
+}
+
+Xsea::CompactNode Xsea::CompactNode::findFirst(StringRef name) const {
+    return CompactNode(_doc, _doc->findFirst(_index, name));
+}
+
+std::size_t Xsea::CompactNode::attributeCount() const {
+    return _doc->attributeCount(_index);
+}
+
+Xsea::StringRef Xsea::CompactNode::attributeKey(std::size_t n) const {
+    return _doc->attributeKey(_index, n);
+}
+
+Xsea::StringRef Xsea::CompactNode::attributeValue(std::size_t n) const {
+    return _doc->attributeValue(_index, n);
+}
+
+bool Xsea::CompactNode::findAttribute(StringRef key, StringRef &value) const {
+    return _doc->findAttribute(_index, key, value);
+}
@@ -1,17 +1,26 @@
+#include <thread>
 #include "../include/xsea.h"
 
-Xsea::Document::Document() : _root(ElementPtr(new Element(nullptr, 0, ""))) {}
 
-Xsea::Document::Document(const char *docName) :
-        _root(ElementPtr(new Element(nullptr, 0, ""))), _filename(docName) {}
+Xsea::Document::Document() {
+    reset();
+}
+
+Xsea::Document::Document(const char *docName) : _filename(docName) {
+    reset();
+}
 
-Xsea::Document::Document(const std::string &docName) :
-        _root(ElementPtr(new Element(nullptr, 0, ""))), _filename(docName) {}
+Xsea::Document::Document(const std::string &docName) : _filename(docName) {
+    reset();
+}
 
 bool Xsea::Document::loadFile() {
     std::ifstream is(_filename);
-    if (!is.is_open())
+    if (!is.is_open()) {
+        _error += "Cannot open file " + _filename + "\n";
         return false;
+    }
+    reset();
     return construct(is);
 }
 
@@ -27,7 +36,43 @@ bool Xsea::Document::loadFile(const std::string &fileName) {
 
 bool Xsea::Document::load(std::istream &is) {
     if (!is) return false;
-    else return construct(is);
+    reset();
+    return construct(is);
+}
+
+bool Xsea::Document::loadBuffer(const char *data, std::size_t size) {
+    return loadBuffer(std::string(data, size));
+}
+
+bool Xsea::Document::loadBuffer(std::string &&buffer) {
+    reset(); // the old nodes may refer into the old buffer
+    auto input = std::make_shared<std::string>(std::move(buffer));
+    _store->retain(input);
+    return construct(input->data(), input->data() + input->size());
+}
+
+bool Xsea::Document::mapFile() {
+    auto file = std::make_shared<MappedFile>(_filename);
+    if (!file->isOpen()) {
+        _error += "Cannot open file " + _filename + "\n";
+        return false;
+    }
+    reset();
+    _store->retain(file);
+    file->adviseSequential(true); // the pages behind the parser can be dropped and read back on demand
+    bool ret = construct(file->data(), file->data() + file->size());
+    file->adviseSequential(false);
+    return ret;
+}
+
+bool Xsea::Document::mapFile(const char *fileName) {
+    this->_filename = fileName;
+    return mapFile();
+}
+
+bool Xsea::Document::mapFile(const std::string &fileName) {
+    this->_filename = fileName;
+    return mapFile();
 }
 
 void Xsea::Document::saveFile() const {
@@ -39,25 +84,18 @@ void Xsea::Document::saveFile(const char *fileName) const {
 }
 
 void Xsea::Document::saveFile(const std::string &fileName) const {
-    std::ofstream os(fileName);
-    if (_declarationPtr != nullptr)
-        os << "<" << _declarationPtr->_value << ">" << std::endl;
-    for (const NodePtr &ptr : _root->_children) {
-        if (ptr->getType() == NodeType::_comment)
-            os << "<!--" << ptr->getValue() << "-->" << std::endl;
-        else if (ptr->getType() == NodeType::_unknown)
-            os << "<" << ptr->getValue() << ">" << std::endl;
-        else if (ptr->getType() == NodeType::_element) {
-            ElementPtr elemPtr = std::dynamic_pointer_cast<Element>(ptr);
-            save(os, elemPtr);
-        }
-    }
+    saveFile(fileName, SaveOptions());
+}
+
+void Xsea::Document::saveFile(const std::string &fileName, const SaveOptions &options) const {
+    std::ofstream os(fileName, std::ios::binary);
+    save(os, options);
 }
 
 Xsea::ElementPtr Xsea::Document::getRootPtr() const {
-    for (const NodePtr &p : _root->_children) {
-        if (p->getType() == NodeType::_element)
-            return std::dynamic_pointer_cast<Element>(p);
+    for (const Node &p : _root->children()) {
+        if (p.getType() == NodeType::_element)
+            return std::static_pointer_cast<Element>(p._link);
     }
     return nullptr;
 }
@@ -71,152 +109,167 @@ const char *Xsea::Document::getNameC() const {
     return _filename.c_str();
 }
 
-bool Xsea::Document::construct(std::istream &is) {
-    std::string line;
-    std::stack<ElementPtr> st;
-    ElementPtr curr = _root;
-    bool oneRoot = false;
-
-    if (std::getline(is, line, '>')) {
-        std::size_t start = startLine(line);
-        if (line.substr(start, 5) == "<?xml") { // there is a declaration
-            _declarationPtr =
-                    DeclarationPtr(new Declaration(nullptr, 0, line.substr(start + 1)));
-            if (!std::getline(is, line, '>')) {
-                _error += "No root tag\n";
-                return false;
-            }
-        }
-    } else {
-        _error += "No root tag.\n";
-        return false; // no root tag
+class Xsea::Document::Builder : public SaxHandler {
+public:
+    Builder(Document &doc, const char *begin, const char *end) :
+            _doc(doc), _curr(doc._root.get()), _begin(begin), _end(end) {
+        Element::openScope(doc._store->names(), _scope);
     }
 
+    bool declaration(StringRef value) override {
+        _doc._declarationPtr = NodeStore::make<Declaration>(_doc._store, nullptr, 0);
+        _doc._declarationPtr->_ref = hold(value);
+        return true;
+    }
 
-    do {
-        std::size_t start = startLine(line);
-        if (start == line.size() - 1) {
-            _error += "Wrong syntax at " + line + '\n';
-            return false;
+    bool startElement(StringRef name, const std::vector<Attribute> &attributes) override {
+        NameTable &names = _doc._store->names();
+        ElementPtr elemPtr = NodeStore::make<Element>(_doc._store, _curr, _curr->_size);
+        elemPtr->_nameId = names.intern(name);
+        elemPtr->_ref = names.name(elemPtr->_nameId);
+        elemPtr->_attributes.reserve(attributes.size());
+        for (const Attribute &attr : attributes) {
+            NameId key = names.intern(attr.getKeyRef());
+            elemPtr->_attributes.push_back(Attribute::refer(names.name(key), hold(attr.getValueRef()), key));
         }
+        _marks.push_back(_scope.size());
+        elemPtr->declare(_scope);
+        elemPtr->bind(_scope);
+        _curr->linkBefore(nullptr, elemPtr);
+        _curr = elemPtr.get();
+        return true;
+    }
 
-        NodeType type = judgeType(line, start);
-        if (type == NodeType::_back) {
-            if (!curr->hasChildren() && line[0] != '<')
-                type = NodeType::_text;
-        }
+    bool endElement(StringRef) override { // the parser has matched the names already
+        _curr = _curr->_parent;
+        _scope.resize(_marks.back());
+        _marks.pop_back();
+        return true;
+    }
 
-        if (oneRoot) { // the remains can only be comments
-            if (type != NodeType::_comment)
-                break;
-        }
+    bool text(StringRef value) override {
+        return add<Text>(value);
+    }
 
-        switch (type) {
-            case NodeType::_element: {
-                curr->_children.emplace_back(
-                        new Element(curr, curr->_children.size(),
-                                    tagName(line)));
-                if (line.back() != '/') // not like <tag/>
-                    curr = std::dynamic_pointer_cast<Element>(curr->_children.back());
-                break;
-            }
-            case NodeType::_back: {
-                std::string tag = tagName(line, start);
-                if (tag != curr->_value) {
-                    _error += "Back tag doesn't match previousPtr tag at " + line + '\n';
-                    return false;
-                }
-                curr = curr->_parent.lock();
-                if (curr == _root) oneRoot = true;
-                break;
-            }
-            case NodeType::_text: {
-                std::string txt = parseText(line);
-                std::size_t tagStart = txt.size();
-                curr->_children.emplace_back(
-                        new Text(curr, curr->_children.size(),
-                                 txt));
-                std::string tag = tagName(line, tagStart);
-                if (tag != curr->_value) {
-                    _error += "Back tag doesn't match previousPtr tag at " + line + '\n';
-                    return false;
-                }
-                curr = curr->_parent.lock();
-                if (curr == _root) oneRoot = true;
-                break;
-            }
-            case NodeType::_comment: {
-                if (line.size() - start < 7) { // <!----> has 7 characters
-                    _error += "Comment syntax error at " + line + '\n';
-                    return false;
-                }
-                curr->_children.emplace_back(
-                        new Comment(curr, curr->_children.size(),
-                                    parseComment(line, start)));
-                break;
-            }
-            case NodeType::_unknown: {
-                curr->_children.emplace_back(
-                        new Unknown(curr, curr->_children.size(),
-                                    line.substr(start + 1)));
-                break;
-            }
-            default:
-                break;
-        }
-    } while (std::getline(is, line, '>'));
+    bool encodedText(StringRef value) override { // in situ the references are decoded on the first read
+        if (value.begin() < _begin || value.end() > _end)
+            return SaxHandler::encodedText(value);
+        add<Text>(value);
+        _curr->_last->_encoded = true;
+        return true;
+    }
 
-    if (!oneRoot) { // there is no root
-        _error += "No root\n";
-        return false;
+    bool comment(StringRef value) override {
+        return add<Comment>(value);
     }
 
-    return true;
-}
+    bool unknown(StringRef value) override {
+        return add<Unknown>(value);
+    }
 
-std::size_t Xsea::Document::startLine(const std::string &line) {
-    return line.find_first_not_of(" \t\v\n\r");
-}
+    bool cdata(StringRef value) override { // in situ a view of the body, however large
+        return add<CData>(value);
+    }
 
+    bool processingInstruction(StringRef value) override {
+        return add<ProcessingInstruction>(value);
+    }
 
-Xsea::NodeType Xsea::Document::judgeType(const std::string &line, std::size_t start) {
-    if (line[start] != '<')
-        return NodeType::_text;
-    else if (line[start + 1] == '/')
-        return NodeType::_back;
-    else if (line.substr(start, 4) == "<!--")
-        return NodeType::_comment;
-    else if (isalpha(line[start + 1]))
-        return NodeType::_element;
-    else
-        return NodeType::_unknown;
-}
+    bool doctype(StringRef value) override {
+        return add<DocType>(value);
+    }
 
-std::string Xsea::Document::tagName(const std::string &line, std::size_t start) {
-    std::size_t b = line.find('<', start);
-    std::string ret;
-    if (line[b + 1] == '/')
-        b++;
-    ret = line.substr(b + 1);
-    if (ret.back() == '/')
-        ret.pop_back();
-    return ret;
+private:
+    Document &_doc;
+    Element *_curr;
+    const char *_begin; // the in-situ input, empty when reading a stream
+    const char *_end;
+    Element::Scope _scope; // the namespace declarations of the open elements
+    std::vector<std::size_t> _marks; // the size of _scope before each open element
+
+    StringRef hold(StringRef value) { // refer into the input when possible, copy into the store otherwise
+        if (value.begin() >= _begin && value.end() <= _end)
+            return value;
+        return _doc._store->keep(value);
+    }
+
+    template<class T>
+    bool add(StringRef value) {
+        auto ptr = NodeStore::make<T>(_doc._store, _curr, _curr->_size);
+        ptr->_ref = hold(value);
+        _curr->linkBefore(nullptr, std::move(ptr));
+        return true;
+    }
+};
+
+class Xsea::Document::Feed {
+public:
+    explicit Feed(Document &doc) : _builder(doc, nullptr, nullptr), _parser(_builder) {
+        _parser.setWhitespace(doc._options.whitespace);
+    }
+
+    Builder _builder; // the chunks go away, every value is copied into the store
+    PushParser _parser;
+};
+
+bool Xsea::Document::feed(const char *data, std::size_t size) {
+    if (_feed == nullptr) {
+        reset();
+        _feed = std::make_shared<Feed>(*this);
+    }
+    if (!_feed->_parser.feed(data, size)) {
+        _error += _feed->_parser.getError();
+        return false;
+    }
+    return true;
 }
 
-std::string Xsea::Document::parseComment(const std::string &line, std::size_t start) {
-    return line.substr(start + 4, line.size() - 4 - 3 - start);
+bool Xsea::Document::finish() {
+    if (_feed == nullptr)
+        return feed(nullptr, 0) && finish();
+    std::shared_ptr<Feed> done = std::move(_feed);
+    if (!done->_parser.good()) // a feed has reported it
+        return false;
+    if (!done->_parser.finish()) {
+        _error += done->_parser.getError();
+        return false;
+    }
+    return true;
 }
 
-std::string Xsea::Document::parseText(const std::string &line) {
-    std::string ret;
-    ret.reserve(line.size() - 2);
-    std::size_t i = 0;
-    if (line[0] == '\n') i++;
+bool Xsea::Document::construct(std::istream &is) {
+    Builder builder(*this, nullptr, nullptr);
+    SaxParser parser(builder);
+    parser.setWhitespace(_options.whitespace);
+    if (!parser.parse(is)) {
+        _error += parser.getError();
+        return false;
+    }
+    return true;
+}
 
-    for (; line[i] != '<' && i < line.size(); i++) {
-        ret.push_back(line[i]);
+bool Xsea::Document::construct(const char *begin, const char *end) {
+    unsigned threads = _options.threads == 0 ? std::thread::hardware_concurrency() : _options.threads;
+    Builder builder(*this, begin, end);
+    SaxParser parser(builder);
+    parser.setWhitespace(_options.whitespace);
+    std::size_t size = static_cast<std::size_t>(end - begin);
+    bool ok = threads > 1 ? parser.parseParallel(begin, size, threads) : parser.parse(begin, size);
+    if (!ok) {
+        _error += parser.getError();
+        return false;
     }
-    return std::move(ret);
+    return true;
+}
+
+void Xsea::Document::reset() { // the old nodes and their input are freed with the old store
+    _index.reset();
+    _feed.reset();
+    if (_names == nullptr)
+        _names = std::make_shared<NameTable>();
+    _store = std::make_shared<NodeStore>(_names);
+    _root = NodeStore::make<Element>(_store, nullptr, 0, "");
+    _declarationPtr.reset();
 }
 
 std::string Xsea::Document::getError() const {
@@ -235,26 +288,50 @@ const char *Xsea::Document::getErrorC() const {
     return _error.c_str();
 }
 
+Xsea::NameTablePtr Xsea::Document::getNameTable() const {
+    return _names;
+}
+
+void Xsea::Document::setNameTable(NameTablePtr names) {
+    _names = std::move(names);
+}
+
+void Xsea::Document::setParseOptions(const ParseOptions &options) {
+    _options = options;
+}
+
+const Xsea::ParseOptions &Xsea::Document::getParseOptions() const {
+    return _options;
+}
+
+Xsea::ElementHandle Xsea::Document::getRootHandle() const {
+    for (Node &p : _root->children()) {
+        if (p.getType() == NodeType::_element)
+            return static_cast<Element *>(&p);
+    }
+    return nullptr;
+}
+
 Xsea::ElementPtr Xsea::Document::getRootPtr() {
-    for (const NodePtr &p : _root->_children) {
-        if (p->getType() == NodeType::_element)
-            return std::dynamic_pointer_cast<Element>(p);
+    for (const Node &p : _root->children()) {
+        if (p.getType() == NodeType::_element)
+            return std::static_pointer_cast<Element>(p._link);
     }
     return nullptr;
 }
 
 const Xsea::Element &Xsea::Document::getRoot() const {
-    for (const NodePtr &p : _root->_children) {
-        if (p->getType() == NodeType::_element)
-            return *std::dynamic_pointer_cast<Element>(p);
+    for (Node &p : _root->children()) {
+        if (p.getType() == NodeType::_element)
+            return static_cast<Element &>(p);
     }
     return *_root;
 }
 
 Xsea::Element &Xsea::Document::getRoot() {
-    for (const NodePtr &p : _root->_children) {
-        if (p->getType() == NodeType::_element)
-            return *std::dynamic_pointer_cast<Element>(p);
+    for (Node &p : _root->children()) {
+        if (p.getType() == NodeType::_element)
+            return static_cast<Element &>(p);
     }
     return *_root;
 }
@@ -266,62 +343,3 @@ const Xsea::Declaration &Xsea::Document::getDeclaration() const {
 Xsea::Declaration &Xsea::Document::getDeclaration() {
     return *_declarationPtr;
 }
-
-void Xsea::Document::save(std::ostream &os, Xsea::ElementPtr ptr, int indent) {
-    if (ptr->_children.empty())
-        os << std::string(static_cast<unsigned long>(indent) * 2, ' ')
-           << "<" << ptr->_value << "/>" << std::endl;
-    else if (ptr->_children.size() == 1 && ptr->_children.front()->getType() != NodeType::_element) {
-        NonelementPtr nptr = std::dynamic_pointer_cast<Nonelement>(ptr->_children.front());
-        os << std::string(static_cast<unsigned long>(indent * 2), ' ')
-           << "<" << ptr->_value << ">";
-        if (nptr->_value.size() < 40) {
-            save(os, nptr);
-            os << "</" << ptr->_value << ">";
-        } else {
-            os << '\n' << std::string(static_cast<unsigned long>(indent * 2 + 2), ' ');
-            save(os, nptr);
-            os << '\n' << std::string(static_cast<unsigned long>(indent * 2), ' ')
-               << "</" << ptr->_value << ">";
-        }
-        os << std::endl;
-    } else {
-        os << std::string(static_cast<unsigned long>(indent * 2), ' ')
-           << "<" << ptr->_value << ">" << std::endl;
-        for (const NodePtr &np : ptr->_children) {
-            if (np->_type == NodeType::_element)
-                save(os, std::dynamic_pointer_cast<Element>(np), indent + 1);
-            else {
-                os << std::string(static_cast<unsigned long>(indent * 2 + 2), ' ');
-                save(os, std::dynamic_pointer_cast<Nonelement>(np));
-                os << std::endl;
-            }
-        }
-        os << std::string(static_cast<unsigned long>(indent * 2), ' ')
-           << "</" << ptr->_value << ">" << std::endl;
-    }
-}
-
-void Xsea::Document::save(std::ostream &os, Xsea::NonelementPtr ptr) {
-    switch (ptr->getType()) {
-        case NodeType::_text: {
-            os << ptr->getValue();
-            return;
-        }
-        case NodeType::_comment: {
-            os << "<!--" << ptr->getValue() << "-->";
-            return;
-        }
-        case NodeType::_unknown: {
-            os << "<" << ptr->getValue() << ">";
-            return;
-        }
-        default:
-            return;
-    }
-}
-
-
-
-
-
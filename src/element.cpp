@@ -1,41 +1,82 @@
 #include <utility>
+#include <algorithm>
 #include "../include/xsea.h"
 
+namespace {
+
+const char xmlUri[] = "http://www.w3.org/XML/1998/namespace";
+const char xmlnsUri[] = "http://www.w3.org/2000/xmlns/";
+
+Xsea::NameId carry(const Xsea::NameTable &from, Xsea::NameTable &to, Xsea::NameId id) { // the same name in to
+    return id == Xsea::noName ? id : to.intern(from.name(id));
+}
+
+bool declares(Xsea::NameTable &names, Xsea::NameId xmlns, const std::vector<Xsea::Attribute> &attributes) {
+    if (xmlns == Xsea::noName)
+        return false;
+    for (const Xsea::Attribute &attr : attributes) {
+        if (attr.getKeyId() == xmlns || (attr.getKeyId() != Xsea::noName && names.prefixOf(attr.getKeyId()) == xmlns))
+            return true;
+    }
+    return false;
+}
+
+bool declares(Xsea::NameTable &names, const std::vector<Xsea::Attribute> &attributes) { // any xmlns or xmlns:p
+    return declares(names, names.find("xmlns"), attributes);
+}
+
+}
+
 bool Xsea::Element::hasChildren() const {
-    return !_children.empty();
+    return _size != 0;
 }
 
-Xsea::Element::Element(Xsea::ElementPtr p, std::size_t index) : Node(std::move(p), index) {
+Xsea::Element::Element(Xsea::Element *p, std::size_t index) : Node(p, index) {
     _type = NodeType::_element;
 }
 
-Xsea::Element::Element(Xsea::ElementPtr p, std::size_t index, const std::string &value) :
-        Node(std::move(p), index, value) {
+Xsea::Element::Element(Xsea::Element *p, std::size_t index, const std::string &value) :
+        Node(p, index, value) {
     _type = NodeType::_element;
 }
 
+Xsea::Element::~Element() {
+    clear();
+}
+
 const Xsea::NodePtr Xsea::Element::frontPtr() const {
-    return _children.front();
+    return _first == nullptr ? nullptr : _first->_link;
 }
 
 Xsea::NodePtr Xsea::Element::frontPtr() {
-    return _children.front();
+    return _first == nullptr ? nullptr : _first->_link;
+}
+
+Xsea::NodeHandle Xsea::Element::frontHandle() const {
+    return _first;
 }
 
 const Xsea::NodePtr Xsea::Element::backPtr() const {
-    return _children.back();
+    return _last == nullptr ? nullptr : _last->_link;
 }
 
 Xsea::NodePtr Xsea::Element::backPtr() {
-    return _children.back();
+    return _last == nullptr ? nullptr : _last->_link;
+}
+
+Xsea::NodeHandle Xsea::Element::backHandle() const {
+    return _last;
 }
 
 std::size_t Xsea::Element::findFirst(const std::string &txt) {
-    for (std::size_t i = 0; i < _children.size(); i++) {
-        if (_children[i]->getValue() == txt)
+    NameId id = _store->names().find(txt); // element names compare by id
+    std::size_t i = 0;
+    for (const Node *child = _first; child != nullptr; child = child->_next, i++) {
+        if (child->_type == NodeType::_element ? static_cast<const Element *>(child)->_nameId == id
+                                               : child->getValueRef() == StringRef(txt))
             return i;
     }
-    return _children.size();
+    return _size;
 }
 
 std::size_t Xsea::Element::findFirst(const char *txt) {
@@ -43,19 +84,159 @@ std::size_t Xsea::Element::findFirst(const char *txt) {
 }
 
 std::size_t Xsea::Element::findFirst(const Xsea::NodePtr ptr) {
-    for (std::size_t i = 0; i < _children.size(); i++) {
-        if (_children[i] == ptr)
+    std::size_t i = 0;
+    for (const Node *child = _first; child != nullptr; child = child->_next, i++) {
+        if (child == ptr.get())
             return i;
     }
-    return _children.size();
+    return _size;
 }
 
 std::size_t Xsea::Element::findLast(const std::string &txt) {
-    for (auto i = static_cast<int>(_children.size() - 1); i >= 0; i--) {
-        if (_children[i]->getValue() == txt)
-            return static_cast<size_t>(i);
+    NameId id = _store->names().find(txt);
+    std::size_t i = _size;
+    for (const Node *child = _last; child != nullptr; child = child->_prev) {
+        i--;
+        if (child->_type == NodeType::_element ? static_cast<const Element *>(child)->_nameId == id
+                                               : child->getValueRef() == StringRef(txt))
+            return i;
+    }
+    return _size;
+}
+
+std::size_t Xsea::Element::findFirst(NameId name) const {
+    std::size_t i = 0;
+    for (const Node *child = _first; child != nullptr; child = child->_next, i++) {
+        if (child->_type == NodeType::_element && static_cast<const Element *>(child)->_nameId == name)
+            return i;
+    }
+    return _size;
+}
+
+std::size_t Xsea::Element::findFirst(NameId ns, NameId local) const {
+    if (local == noName)
+        return _size;
+    std::size_t i = 0;
+    for (const Node *child = _first; child != nullptr; child = child->_next, i++) {
+        if (child->_type == NodeType::_element && static_cast<const Element *>(child)->_localId == local &&
+            static_cast<const Element *>(child)->_nsId == ns)
+            return i;
+    }
+    return _size;
+}
+
+Xsea::NameId Xsea::Element::getNameId() const {
+    return _nameId;
+}
+
+Xsea::NameId Xsea::Element::getNamespaceId() const {
+    return _nsId;
+}
+
+Xsea::NameId Xsea::Element::getLocalNameId() const {
+    return _localId;
+}
+
+void Xsea::Element::rename(StringRef name) {
+    _nameId = _store->names().intern(name);
+    _ref = _store->names().name(_nameId);
+    _value.clear();
+    resolve();
+}
+
+void Xsea::Element::openScope(NameTable &names, Scope &scope) {
+    scope.clear();
+    scope.emplace_back(names.intern("xml"), names.intern(xmlUri));
+    scope.emplace_back(names.intern("xmlns"), names.intern(xmlnsUri));
+}
+
+void Xsea::Element::declare(Scope &scope) const {
+    NameTable &names = _store->names();
+    NameId xmlns = scope[1].first;
+    for (const Attribute &attr : _attributes) {
+        if (attr._keyId == noName)
+            continue;
+        NameId prefix = attr._keyId == xmlns ? xmlns : names.parts(attr._keyId).first; // xmlns alone declares the default
+        if (prefix == xmlns)
+            scope.emplace_back(attr._keyId == xmlns ? noName : names.parts(attr._keyId).second,
+                               attr._value.empty() ? noName : names.intern(attr._value)); // "" takes it away
+    }
+}
+
+void Xsea::Element::bind(const Scope &scope) {
+    NameTable &names = _store->names();
+    auto lookup = [&scope](NameId prefix) { // an undeclared prefix is left without a namespace
+        for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
+            if (it->first == prefix)
+                return it->second;
+        }
+        return noName;
+    };
+    if (_nameId != noName) {
+        std::pair<NameId, NameId> parts = names.parts(_nameId);
+        _nsId = lookup(parts.first);
+        _localId = parts.second;
+    }
+    NameId xmlns = scope[1].first;
+    for (Attribute &attr : _attributes) {
+        if (attr._keyId == noName)
+            continue;
+        std::pair<NameId, NameId> parts = names.parts(attr._keyId);
+        attr._nsId = parts.first != noName ? lookup(parts.first) : attr._keyId == xmlns ? scope[1].second : noName;
+        attr._localId = parts.second;
+    }
+}
+
+void Xsea::Element::inScope(Scope &scope) const {
+    std::vector<const Element *> chain; // this element up to the top
+    for (const Element *elem = this; elem != nullptr; elem = elem->_parent)
+        chain.push_back(elem);
+    openScope(_store->names(), scope);
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        (*it)->declare(scope);
+}
+
+void Xsea::Element::resolve(bool subtree) {
+    Scope scope;
+    if (_parent != nullptr)
+        _parent->inScope(scope);
+    else
+        openScope(_store->names(), scope);
+    rescope(std::move(scope), subtree, ElementIndex::of(*this));
+}
+
+void Xsea::Element::rescope(Scope scope, bool subtree, ElementIndex *index) {
+    declare(scope);
+    bind(scope);
+    if (!subtree)
+        return;
+    // one preorder walk, the scope grows and shrinks with the open elements, no recursion for deep trees
+    std::vector<std::size_t> marks; // the scope size below each open descendant
+    Node *node = _first;
+    while (node != nullptr) {
+        if (node->_type == NodeType::_element) {
+            auto &elem = static_cast<Element &>(*node);
+            marks.push_back(scope.size());
+            elem.declare(scope);
+            elem.bind(scope);
+            if (index != nullptr)
+                index->namespacesEdited(elem);
+            if (elem._first != nullptr) {
+                node = elem._first;
+                continue;
+            }
+            scope.resize(marks.back());
+            marks.pop_back();
+        }
+        while (node->_next == nullptr) { // climb out of the elements that are done
+            node = node->_parent;
+            if (node == this)
+                return;
+            scope.resize(marks.back());
+            marks.pop_back();
+        }
+        node = node->_next;
     }
-    return _children.size();
 }
 
 std::size_t Xsea::Element::findLast(const char *txt) {
@@ -63,56 +244,127 @@ std::size_t Xsea::Element::findLast(const char *txt) {
 }
 
 std::size_t Xsea::Element::findLast(Xsea::NodePtr ptr) {
-    for (auto i = static_cast<int>(_children.size() - 1); i >= 0; i--) {
-           if (_children[i] == ptr)
-               return static_cast<size_t>(i);
+    std::size_t i = _size;
+    for (const Node *child = _last; child != nullptr; child = child->_prev) {
+        i--;
+        if (child == ptr.get())
+            return i;
     }
-    return _children.size();
+    return _size;
 }
 
 const Xsea::NodePtr Xsea::Element::ptrAt(std::size_t index) const {
-    return _children[index];
+    return positionAt(index)->_link;
 }
 
 Xsea::NodePtr Xsea::Element::ptrAt(std::size_t index) {
-    return _children[index];
+    return positionAt(index)->_link;
 }
 
-
-
+Xsea::NodeHandle Xsea::Element::handleAt(std::size_t index) const {
+    return positionAt(index);
+}
 
 void Xsea::Element::addAttribute(const Xsea::Attribute &attribute) {
-    _attributes.push_back(attribute);
+    ElementIndex *index = ElementIndex::of(*this);
+    if (index != nullptr)
+        index->detaching(*this, false);
+    NameId key = _store->names().intern(attribute.getKeyRef());
+    _attributes.push_back(Attribute::refer(_store->names().name(key), _store->keep(attribute.getValueRef()), key));
+    _attributeOrder.clear();
+    NameTable &names = _store->names();
+    NameId xmlns = names.find("xmlns");
+    resolve(key == xmlns || names.prefixOf(key) == xmlns); // a declaration reaches the descendants too
+    if (index != nullptr)
+        index->attached(*this, false);
 }
 
 Xsea::Attribute Xsea::Element::getAttribute(const std::string &key) const {
-    auto iter = std::find_if(_attributes.begin(), _attributes.end(),
-            [&](const Attribute& a) {
-        return a.first == key;
-    });
-    return *iter;
+    const Attribute *attr = findAttribute(key);
+    if (attr == nullptr)
+        return Attribute("", "");
+    return *attr;
+}
+
+const Xsea::Attribute *Xsea::Element::findAttribute(StringRef key) const {
+    NameId id = _store->names().find(key);
+    return id == noName ? nullptr : findAttribute(id);
+}
+
+const Xsea::Attribute *Xsea::Element::findAttribute(NameId key) const {
+    if (_attributesDirty) { // the caller may have added or replaced attributes
+        for (Attribute &attr : const_cast<std::vector<Attribute> &>(_attributes))
+            attr._keyId = _store->names().intern(attr.getKeyRef());
+        _attributeOrder.clear();
+        _attributesDirty = false;
+        const_cast<Element *>(this)->resolve(_declaredDirty || declares(_store->names(), _attributes));
+        _declaredDirty = false;
+    }
+    if (_attributes.size() <= linearAttributes) {
+        for (const Attribute &attr : _attributes) {
+            if (attr._keyId == key)
+                return &attr;
+        }
+        return nullptr;
+    }
+    if (_attributeOrder.size() != _attributes.size()) {
+        _attributeOrder.resize(_attributes.size());
+        for (std::uint32_t i = 0; i < _attributeOrder.size(); i++)
+            _attributeOrder[i] = i;
+        std::sort(_attributeOrder.begin(), _attributeOrder.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return _attributes[a]._keyId < _attributes[b]._keyId;
+        });
+    }
+    auto iter = std::lower_bound(_attributeOrder.begin(), _attributeOrder.end(), key,
+                                 [&](std::uint32_t i, NameId k) {
+                                     return _attributes[i]._keyId < k;
+                                 });
+    if (iter == _attributeOrder.end() || _attributes[*iter]._keyId != key)
+        return nullptr;
+    return &_attributes[*iter];
 }
 
 void Xsea::Element::clear() {
-    Node::clear();
-    _children.clear();
+    ElementIndex *index = ElementIndex::of(*this);
+    if (index != nullptr)
+        index->detaching(*this, true);
+    Node *child = _first;
+    while (child != nullptr) { // one by one, so a long run of siblings does not unwind recursively
+        Node *next = child->_next;
+        child->_parent = nullptr;
+        child->_prev = nullptr;
+        child->_next = nullptr;
+        NodePtr drop = std::move(child->_link);
+        child = next;
+    }
+    _first = _last = nullptr;
+    _size = 0;
+    _ordered = true;
+    _positioned = false;
+    _positions.clear();
     _attributes.clear();
+    _attributeOrder.clear();
+    _attributesDirty = false;
+    _declaredDirty = false;
+    resolve(); // its own declarations went with the attributes
+    if (index != nullptr) // still linked, only the children and attributes are gone
+        index->attached(*this, false);
 }
 
 const Xsea::Node &Xsea::Element::front() const {
-    return *_children.front();
+    return *_first;
 }
 
 Xsea::Node &Xsea::Element::front() {
-    return *_children.front();
+    return *_first;
 }
 
 const Xsea::Node &Xsea::Element::back() const {
-    return *_children.back();
+    return *_last;
 }
 
 Xsea::Node &Xsea::Element::back() {
-    return *_children.back();
+    return *_last;
 }
 
 const std::vector<Xsea::Attribute> &Xsea::Element::getAllAttributes() const {
@@ -120,43 +372,223 @@ const std::vector<Xsea::Attribute> &Xsea::Element::getAllAttributes() const {
 }
 
 std::vector<Xsea::Attribute> &Xsea::Element::getAllAttributes() {
+    ElementIndex *index = ElementIndex::of(*this);
+    if (index != nullptr)
+        index->attributesEdited(*this);
+    if (!_attributesDirty) // the ids are still right, a declaration taken away moves the descendants too
+        _declaredDirty = declares(_store->names(), _attributes);
+    _attributesDirty = true;
     return _attributes;
 }
 
 const Xsea::Node &Xsea::Element::at(std::size_t index) const {
-    return *_children[index];
+    return *positionAt(index);
 }
 
 Xsea::Node &Xsea::Element::at(std::size_t index) {
-    return *_children[index];
+    return *positionAt(index);
 }
 
 std::size_t Xsea::Element::size() const {
-    return _children.size();
+    return _size;
 }
 
+Xsea::NodeRange<Xsea::Node> Xsea::Element::children() const {
+    return NodeRange<Node>(_first, &Node::nextOf);
+}
 
-Xsea::NodePtr Xsea::Element::add(Xsea::NodeType type, const std::string &value) {
-    auto thisPtr = std::dynamic_pointer_cast<Element>(shared_from_this());
+Xsea::NodePtr Xsea::Element::make(Xsea::NodeType type, std::size_t index, const std::string &value) {
+    NodeStorePtr store = _store->shared_from_this();
     switch (type) {
         case NodeType::_element: {
-            _children.emplace_back(new Element(thisPtr, _children.size(), value));
-            return _children.back();
-        }
-        case NodeType::_text: {
-            _children.emplace_back(new Text(thisPtr, _children.size(), value));
-            return _children.back();
-        }
-        case NodeType::_comment: {
-            _children.emplace_back(new Comment(thisPtr, _children.size(), value));
-            return _children.back();
+            ElementPtr elemPtr = NodeStore::make<Element>(store, this, index);
+            elemPtr->rename(value);
+            return elemPtr;
         }
-        case NodeType::_unknown: {
-            _children.emplace_back(new Unknown(thisPtr, _children.size(), value));
-            return _children.back();
+        case NodeType::_text:
+            return NodeStore::make<Text>(store, this, index, value);
+        case NodeType::_comment:
+            return NodeStore::make<Comment>(store, this, index, value);
+        case NodeType::_unknown:
+            return NodeStore::make<Unknown>(store, this, index, value);
+        case NodeType::_cdata:
+            return NodeStore::make<CData>(store, this, index, value);
+        case NodeType::_instruction:
+            return NodeStore::make<ProcessingInstruction>(store, this, index, value);
+        case NodeType::_doctype:
+            return NodeStore::make<DocType>(store, this, index, value);
+        default:
+            return nullptr;
+    }
+}
+
+void Xsea::Element::rebind(Node &node) {
+    NameTable &names = _store->names();
+    const NameTable &from = node._store->names();
+    if (&from == &names)
+        return;
+    node._store = _store; // new children and renames go through the names of this store from now on
+    if (node._type != NodeType::_element)
+        return;
+    auto &elem = static_cast<Element &>(node);
+    elem._nameId = names.intern(elem.getValueRef());
+    elem._ref = names.name(elem._nameId);
+    elem._value.clear();
+    elem._nsId = carry(from, names, elem._nsId); // until it is bound again where it lands
+    elem._localId = carry(from, names, elem._localId);
+    for (Attribute &attr : elem._attributes) {
+        attr._keyId = names.intern(attr.getKeyRef());
+        attr._nsId = carry(from, names, attr._nsId);
+        attr._localId = carry(from, names, attr._localId);
+        if (!attr._owned)
+            attr._key = names.name(attr._keyId);
+    }
+    elem._attributeOrder.clear();
+    for (Node *child = elem._first; child != nullptr; child = child->_next)
+        rebind(*child);
+}
+
+bool Xsea::Element::sameScope(const Element &from) const {
+    if (&from == this)
+        return true;
+    NameTable &names = _store->names();
+    if (&from._store->names() != &names) // the ids cannot be compared
+        return false;
+    NameId xmlns = names.find("xmlns");
+    // no declaration between either side and the nearest ancestor they share
+    std::size_t depthThere = 0, depthHere = 0;
+    for (const Element *elem = &from; elem != nullptr; elem = elem->_parent)
+        depthThere++;
+    for (const Element *elem = this; elem != nullptr; elem = elem->_parent)
+        depthHere++;
+    const Element *there = &from, *here = this;
+    for (; depthThere > depthHere; depthThere--, there = there->_parent) {
+        if (declares(names, xmlns, there->_attributes))
+            return false;
+    }
+    for (; depthHere > depthThere; depthHere--, here = here->_parent) {
+        if (declares(names, xmlns, here->_attributes))
+            return false;
+    }
+    for (; there != here; there = there->_parent, here = here->_parent) {
+        if (declares(names, xmlns, there->_attributes) || declares(names, xmlns, here->_attributes))
+            return false;
+    }
+    return true;
+}
+
+void Xsea::Element::adopt(Node &child) {
+    if (child._type != NodeType::_element)
+        return;
+    Scope scope;
+    inScope(scope);
+    static_cast<Element &>(child).rescope(std::move(scope), true, nullptr); // the index learns of it when linked
+}
+
+void Xsea::Element::noteLinked(Node &child) {
+    if (child._type != NodeType::_element)
+        return;
+    ElementIndex *index = ElementIndex::of(*this);
+    if (index != nullptr)
+        index->attached(static_cast<Element &>(child), true);
+}
+
+void Xsea::Element::noteUnlinking(Node &child) {
+    if (child._type != NodeType::_element)
+        return;
+    ElementIndex *index = ElementIndex::of(*this);
+    if (index != nullptr)
+        index->detaching(static_cast<Element &>(child), true);
+}
+
+bool Xsea::Element::encloses(const Node &node) const {
+    for (const Element *elem = this; elem != nullptr; elem = elem->_parent) {
+        if (elem == &node)
+            return true;
+    }
+    return false;
+}
+
+void Xsea::Element::linkBefore(Node *next, NodePtr child) {
+    Node *node = child.get();
+    node->_parent = this;
+    node->_next = next;
+    node->_prev = next == nullptr ? _last : next->_prev;
+    (node->_prev == nullptr ? _first : node->_prev->_next) = node;
+    (next == nullptr ? _last : next->_prev) = node;
+    if (next == nullptr) { // appending keeps the numbering and the positions
+        node->_index = _size;
+        if (_positioned)
+            _positions.push_back(node);
+    } else {
+        _ordered = false;
+        _positioned = false;
+    }
+    _size++;
+    node->_link = std::move(child);
+}
+
+Xsea::NodePtr Xsea::Element::unlinkChild(Node *child) {
+    (child->_prev == nullptr ? _first : child->_prev->_next) = child->_next;
+    (child->_next == nullptr ? _last : child->_next->_prev) = child->_prev;
+    if (child->_next == nullptr) {
+        if (_positioned)
+            _positions.pop_back();
+    } else {
+        _ordered = false;
+        _positioned = false;
+    }
+    _size--;
+    child->_parent = nullptr;
+    child->_prev = nullptr;
+    child->_next = nullptr;
+    return std::move(child->_link);
+}
+
+Xsea::Node *Xsea::Element::nodeAt(std::size_t index) const {
+    if (_positioned)
+        return _positions[index];
+    Node *node;
+    if (index < _size / 2) {
+        node = _first;
+        for (std::size_t i = 0; i < index; i++)
+            node = node->_next;
+    } else {
+        node = _last;
+        for (std::size_t i = _size - 1; i > index; i--)
+            node = node->_prev;
+    }
+    return node;
+}
+
+Xsea::Node *Xsea::Element::positionAt(std::size_t index) const {
+    if (!_positioned) {
+        _positions.clear();
+        _positions.reserve(_size);
+        for (Node *child = _first; child != nullptr; child = child->_next) {
+            child->_index = _positions.size();
+            _positions.push_back(child);
         }
-        default: return thisPtr;
+        _ordered = true;
+        _positioned = true;
     }
+    return _positions[index];
+}
+
+void Xsea::Element::renumber() const {
+    std::size_t i = 0;
+    for (Node *child = _first; child != nullptr; child = child->_next)
+        child->_index = i++;
+    _ordered = true;
+}
+
+Xsea::NodePtr Xsea::Element::add(Xsea::NodeType type, const std::string &value) {
+    NodePtr newPtr = make(type, _size, value);
+    if (newPtr == nullptr)
+        return shared_from_this();
+    linkBefore(nullptr, newPtr);
+    noteLinked(*newPtr);
+    return newPtr;
 }
 
 Xsea::NodePtr Xsea::Element::add(Xsea::NodeType type, const char *value) {
@@ -164,64 +596,23 @@ Xsea::NodePtr Xsea::Element::add(Xsea::NodeType type, const char *value) {
 }
 
 Xsea::NodePtr Xsea::Element::link(Xsea::NodePtr ptr) {
-    NodeType type = ptr->getType();
-    auto thisPtr = std::dynamic_pointer_cast<Element>(shared_from_this());
-    switch (type) {
-        case NodeType::_element: {
-            ElementPtr newPtr(new Element(thisPtr, _children.size(), ptr->getValue()));
-            ElementPtr tmpPtr = std::dynamic_pointer_cast<Element>(ptr);
-            newPtr->_children = tmpPtr->_children;
-            newPtr->_attributes = tmpPtr->_attributes;
-            _children.push_back(newPtr);
-            return newPtr;
-        }
-        case NodeType::_text: {
-            TextPtr newPtr(new Text(thisPtr, _children.size(), ptr->getValue()));
-            _children.push_back(newPtr);
-            return newPtr;
-        }
-        case NodeType::_comment: {
-            CommentPtr newPtr(new Comment(thisPtr, _children.size(), ptr->getValue()));
-            _children.push_back(newPtr);
-            return newPtr;
-        }
-        case NodeType::_unknown: {
-            UnknownPtr newPtr(new Unknown(thisPtr, _children.size(), ptr->getValue()));
-            _children.push_back(newPtr);
-            return newPtr;
-        }
-        default: return ptr;
-    }
+    NodePtr newPtr = ptr->deepClone();
+    if (newPtr == nullptr)
+        return ptr;
+    rebind(*newPtr);
+    linkBefore(nullptr, newPtr);
+    adopt(*newPtr);
+    noteLinked(*newPtr);
+    return newPtr;
 }
 
 Xsea::NodePtr Xsea::Element::insert(std::size_t index,
                                     Xsea::NodeType type, const std::string &value) {
-    NodePtr newPtr;
-    switch (type) {
-        case NodeType::_element: {
-            newPtr.reset(new Element(_parent.lock(), _index, value));
-            break;
-        }
-        case NodeType::_text: {
-            newPtr.reset(new Text(_parent.lock(), _index, value));
-            break;
-        }
-        case NodeType::_comment: {
-            newPtr.reset(new Comment(_parent.lock(), _index, value));
-            break;
-        }
-        case NodeType::_unknown: {
-            newPtr.reset(new Unknown(_parent.lock(), _index, value));
-            break;
-        }
-        default: return newPtr;
-    }
-    _children.push_back(nullptr);
-    for (auto i = _children.size() - 1; i > index; i--) {
-        _children[i] = _children[i - 1];
-        _children[i]->_index = i;
-    }
-    _children[index] = newPtr;
+    NodePtr newPtr = make(type, index, value);
+    if (newPtr == nullptr)
+        return newPtr;
+    linkBefore(index < _size ? nodeAt(index) : nullptr, newPtr);
+    noteLinked(*newPtr);
     return newPtr;
 }
 
@@ -230,68 +621,236 @@ Xsea::NodePtr Xsea::Element::insert(std::size_t index, Xsea::NodeType type, cons
 }
 
 Xsea::NodePtr Xsea::Element::link(std::size_t index, Xsea::NodePtr ptr) {
-    NodePtr retPtr;
-    NodeType type = ptr->getType();
-    auto thisPtr = std::dynamic_pointer_cast<Element>(shared_from_this());
-    switch (type) {
-        case NodeType::_element: {
-            ElementPtr newPtr(new Element(thisPtr, _children.size(), ptr->getValue()));
-            ElementPtr tmpPtr = std::dynamic_pointer_cast<Element>(ptr);
-            newPtr->_children = tmpPtr->_children;
-            newPtr->_attributes = tmpPtr->_attributes;
-            retPtr = newPtr;
-            break;
-        }
-        case NodeType::_text: {
-            TextPtr newPtr(new Text(thisPtr, _children.size(), ptr->getValue()));
-            retPtr = newPtr;
-            break;
-        }
-        case NodeType::_comment: {
-            CommentPtr newPtr(new Comment(thisPtr, _children.size(), ptr->getValue()));
-            retPtr = newPtr;
-            break;
-        }
-        case NodeType::_unknown: {
-            UnknownPtr newPtr(new Unknown(thisPtr, _children.size(), ptr->getValue()));
-            retPtr = newPtr;
-            break;
-        }
-        default: return ptr;
-    }
-    _children.push_back(nullptr);
-    for (auto i = _children.size() - 1; i > index; i--) {
-        _children[i] = _children[i - 1];
-        _children[i]->_index = i;
-    }
-    _children[index] = retPtr;
+    NodePtr retPtr = ptr->deepClone();
+    if (retPtr == nullptr)
+        return ptr;
+    rebind(*retPtr);
+    linkBefore(index < _size ? nodeAt(index) : nullptr, retPtr);
+    adopt(*retPtr);
+    noteLinked(*retPtr);
     return retPtr;
 }
 
 Xsea::NodePtr Xsea::Element::remove() {
-    _children.pop_back();
-    return _children.back();
+    if (_last == nullptr)
+        return nullptr;
+    noteUnlinking(*_last);
+    unlinkChild(_last);
+    return backPtr();
 }
 
 Xsea::NodePtr Xsea::Element::remove(std::size_t index) {
-    std::size_t sz = _children.size() - 1;
-    for (std::size_t i = index; i < sz; i++) {
-        _children[i] = _children[i + 1];
-        _children[i]->_index = i;
+    if (index >= _size)
+        return nullptr;
+    Node *child = nodeAt(index);
+    Node *prev = child->_prev;
+    noteUnlinking(*child);
+    unlinkChild(child);
+    return prev == nullptr ? nullptr : prev->_link;
+}
+
+Xsea::NodePtr Xsea::Element::insertBefore(NodeHandle next, NodeType type, const std::string &value) {
+    if (next != nullptr && next->_parent != this)
+        return nullptr;
+    NodePtr newPtr = make(type, _size, value);
+    if (newPtr == nullptr)
+        return newPtr;
+    linkBefore(next, newPtr);
+    noteLinked(*newPtr);
+    return newPtr;
+}
+
+Xsea::NodePtr Xsea::Element::unlink(NodeHandle child) {
+    if (child == nullptr || child->_parent != this)
+        return nullptr;
+    noteUnlinking(*child);
+    return unlinkChild(child);
+}
+
+Xsea::NodePtr Xsea::Element::insertRange(std::size_t index,
+                                         const std::vector<std::pair<NodeType, std::string>> &nodes) {
+    Node *next = index < _size ? nodeAt(index) : nullptr; // found once, the new nodes go in front of it
+    NodePtr first;
+    for (const std::pair<NodeType, std::string> &node : nodes) {
+        NodePtr newPtr = make(node.first, _size, node.second);
+        if (newPtr == nullptr)
+            continue;
+        if (first == nullptr)
+            first = newPtr;
+        Node &made = *newPtr;
+        linkBefore(next, std::move(newPtr));
+        noteLinked(made);
+    }
+    return first;
+}
+
+void Xsea::Element::removeRange(std::size_t index, std::size_t count) {
+    if (index >= _size)
+        return;
+    Node *child = nodeAt(index);
+    for (; child != nullptr && count > 0; count--) {
+        Node *next = child->_next;
+        noteUnlinking(*child);
+        unlinkChild(child);
+        child = next;
+    }
+}
+
+Xsea::NodePtr Xsea::Element::moveChild(NodeHandle child) {
+    return moveBefore(nullptr, child);
+}
+
+Xsea::NodePtr Xsea::Element::moveChild(std::size_t index, NodeHandle child) {
+    if (child == nullptr)
+        return nullptr;
+    Node *next = index < _size ? nodeAt(index) : nullptr;
+    if (next == child) // already there
+        return child->_link;
+    return moveBefore(next, child);
+}
+
+Xsea::NodePtr Xsea::Element::moveBefore(NodeHandle next, NodeHandle child) {
+    if (child == nullptr || child == next || child->_type == NodeType::_declaration || encloses(*child) ||
+        (next != nullptr && next->_parent != this))
+        return nullptr;
+    bool kept = child->_parent != nullptr && sameScope(*child->_parent);
+    if (child->_parent != nullptr)
+        child->_parent->noteUnlinking(*child);
+    NodePtr ptr = child->_parent != nullptr ? child->_parent->unlinkChild(child) : child->shared_from_this();
+    rebind(*child);
+    linkBefore(next, ptr);
+    if (!kept)
+        adopt(*child);
+    noteLinked(*child);
+    return ptr;
+}
+
+std::size_t Xsea::Element::splice(NodeHandle next, Element &from, NodeHandle first, NodeHandle last) {
+    if (first == nullptr || first->_parent != &from || (next != nullptr && next->_parent != this))
+        return 0;
+    if (last == nullptr)
+        last = from._last;
+    std::size_t count = 1;
+    for (Node *node = first; node != last; node = node->_next, count++) {
+        if (node == nullptr || node == next) // last comes before first, or next is inside the run
+            return 0;
+    }
+    if (last == next)
+        return 0;
+    for (const Element *elem = this; elem != nullptr; elem = elem->_parent) { // no run member may enclose this
+        if (elem->_parent == &from) {
+            for (Node *node = first; node != last->_next; node = node->_next) {
+                if (node == elem)
+                    return 0;
+            }
+            break;
+        }
+    }
+    if (&from == this && last->_next == next) // already in place
+        return count;
+    bool kept = sameScope(from);
+    for (Node *node = first; node != last->_next; node = node->_next)
+        from.noteUnlinking(*node);
+    // cut the run out of from
+    (first->_prev == nullptr ? from._first : first->_prev->_next) = last->_next;
+    (last->_next == nullptr ? from._last : last->_next->_prev) = first->_prev;
+    from._size -= count;
+    from._ordered = false;
+    from._positioned = false;
+    // and put it back before next
+    first->_prev = next == nullptr ? _last : next->_prev;
+    last->_next = next;
+    (first->_prev == nullptr ? _first : first->_prev->_next) = first;
+    (next == nullptr ? _last : next->_prev) = last;
+    _size += count;
+    _ordered = false;
+    _positioned = false;
+    for (Node *node = first; node != next; node = node->_next) {
+        node->_parent = this;
+        rebind(*node);
+        if (!kept)
+            adopt(*node);
+        noteLinked(*node);
     }
-    _children.pop_back();
-    return index == 0 ? nullptr : _children[index - 1];
+    return count;
+}
+
+
+Xsea::Attribute::Attribute(const std::string &key, const std::string &value) {
+    own(key, value);
 }
 
+Xsea::Attribute Xsea::Attribute::refer(StringRef key, StringRef value, NameId keyId) {
+    Attribute ret;
+    ret._key = key;
+    ret._value = value;
+    ret._keyId = keyId;
+    return ret;
+}
 
-Xsea::Attribute::Attribute(const std::string &key, const std::string &value) :
-        pair(key, value) { }
+Xsea::Attribute::Attribute(const Xsea::Attribute &other) :
+        _key(other._key), _value(other._value), _keyId(other._keyId), _nsId(other._nsId), _localId(other._localId) {
+    if (other._owned)
+        own(other._key, other._value);
+}
+
+Xsea::Attribute &Xsea::Attribute::operator=(const Xsea::Attribute &other) {
+    if (this == &other)
+        return *this;
+    _keyId = other._keyId;
+    _nsId = other._nsId;
+    _localId = other._localId;
+    if (other._owned) {
+        own(other._key, other._value);
+    } else {
+        _key = other._key;
+        _value = other._value;
+        _storage.clear();
+        _owned = false;
+    }
+    return *this;
+}
 
 std::string Xsea::Attribute::getKey() const {
-    return first;
+    return _key.str();
 }
 
 std::string Xsea::Attribute::getValue() const {
-    return second;
+    return _value.str();
+}
+
+Xsea::StringRef Xsea::Attribute::getKeyRef() const {
+    return _key;
+}
+
+Xsea::StringRef Xsea::Attribute::getValueRef() const {
+    return _value;
+}
+
+Xsea::NameId Xsea::Attribute::getKeyId() const {
+    return _keyId;
+}
+
+Xsea::NameId Xsea::Attribute::getNamespaceId() const {
+    return _nsId;
 }
 
+Xsea::NameId Xsea::Attribute::getLocalNameId() const {
+    return _localId;
+}
+
+void Xsea::Attribute::setValue(const std::string &value) {
+    std::string key = _key.str(); // _key may point into _storage
+    own(key, value);
+}
+
+void Xsea::Attribute::own(StringRef key, StringRef value) {
+    std::string storage;
+    storage.reserve(key.size() + value.size());
+    storage.append(key.data(), key.size());
+    storage.append(value.data(), value.size());
+    _storage.swap(storage);
+    _key = StringRef(_storage.data(), key.size());
+    _value = StringRef(_storage.data() + key.size(), value.size());
+    _owned = true;
+}
@@ -0,0 +1,81 @@
+#include <cstring>
+#include "../include/xsea.h"
+
+namespace {
+
+void appendUtf8(std::string &out, unsigned long code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// the reference starting at in[0] == '&', its length or 0 when it is not one
+std::size_t decodeOne(Xsea::StringRef in, std::string &out) {
+    auto semi = static_cast<const char *>(std::memchr(in.data(), ';', in.size() < 12 ? in.size() : 12));
+    if (semi == nullptr)
+        return 0;
+    Xsea::StringRef name(in.data() + 1, static_cast<std::size_t>(semi - in.data() - 1));
+    std::size_t length = name.size() + 2;
+    if (name == Xsea::StringRef("lt")) out.push_back('<');
+    else if (name == Xsea::StringRef("gt")) out.push_back('>');
+    else if (name == Xsea::StringRef("amp")) out.push_back('&');
+    else if (name == Xsea::StringRef("quot")) out.push_back('"');
+    else if (name == Xsea::StringRef("apos")) out.push_back('\'');
+    else if (name.size() > 1 && name[0] == '#') {
+        bool hex = name[1] == 'x' || name[1] == 'X';
+        std::size_t i = hex ? 2 : 1;
+        if (i == name.size())
+            return 0;
+        unsigned long code = 0;
+        for (; i < name.size(); i++) {
+            char c = name[i];
+            int digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (hex && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (hex && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else return 0;
+            code = code * (hex ? 16 : 10) + static_cast<unsigned long>(digit);
+        }
+        if (code == 0 || code > 0x10FFFF)
+            return 0;
+        appendUtf8(out, code);
+    } else {
+        return 0;
+    }
+    return length;
+}
+
+}
+
+bool Xsea::decodeEntities(StringRef in, std::string &out) {
+    auto amp = static_cast<const char *>(std::memchr(in.data(), '&', in.size()));
+    if (amp == nullptr)
+        return false;
+    out.clear();
+    const char *p = in.data();
+    const char *end = in.end();
+    while (amp != nullptr) {
+        out.append(p, amp);
+        std::size_t length = decodeOne(StringRef(amp, static_cast<std::size_t>(end - amp)), out);
+        if (length == 0) { // not a reference we know, keep it as it is
+            out.push_back('&');
+            length = 1;
+        }
+        p = amp + length;
+        amp = static_cast<const char *>(std::memchr(p, '&', static_cast<std::size_t>(end - p)));
+    }
+    out.append(p, end);
+    return true;
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstring>
+#include "../include/xsea.h"
+
+namespace {
+
+inline bool isNameChar(char c) {
+    return c != '/' && c != '@' && c != ' ' && c != '\t' && c != '\n' && c != '\r';
+}
+
+}
+
+const std::uint32_t Xsea::PathFilter::unknown;
+const std::uint32_t Xsea::PathFilter::dead;
+const std::uint32_t Xsea::PathFilter::top;
+
+Xsea::PathFilter::PathFilter(PathHandler &handler) : _handler(handler), _trie(1) {}
+
+std::size_t Xsea::PathFilter::add(const std::string &path) {
+    const char *p = path.data();
+    const char *end = p + path.size();
+    if (p == end || *p != '/') {
+        _error += "Path must start with / in " + path + '\n';
+        return npos;
+    }
+    // check the whole path before the trie is touched
+    std::vector<std::pair<bool, std::string>> steps; // descendant, name
+    std::string key;
+    bool text = false;
+    while (p < end) {
+        if (*p != '/' || text || !key.empty()) {
+            _error += "Unexpected step in " + path + '\n';
+            return npos;
+        }
+        p++;
+        bool descendant = p < end && *p == '/';
+        if (descendant)
+            p++;
+        bool attribute = p < end && *p == '@';
+        if (attribute)
+            p++;
+        const char *name = p;
+        while (p < end && isNameChar(*p))
+            p++;
+        std::string step(name, p);
+        if (step.empty() || ((attribute || step == "text()") && (descendant || steps.empty()))) {
+            _error += "Bad step in " + path + '\n';
+            return npos;
+        }
+        if (attribute)
+            key = step;
+        else if (step == "text()")
+            text = true;
+        else
+            steps.emplace_back(descendant, step);
+    }
+    std::size_t node = 0;
+    for (const std::pair<bool, std::string> &step : steps) {
+        NameId name = step.second == "*" ? noName : _names.intern(step.second);
+        std::size_t target = _trie.size();
+        for (const Edge &edge : _trie[node].edges) {
+            if (edge.name == name && edge.descendant == step.first)
+                target = edge.target;
+        }
+        if (target == _trie.size()) {
+            _trie[node].edges.push_back(Edge{name, step.first, target});
+            _trie[node].loops = _trie[node].loops || step.first;
+            _trie.emplace_back();
+        }
+        node = target;
+    }
+    if (key.empty())
+        _trie[node].texts.push_back(_paths);
+    else
+        _trie[node].attributes.emplace_back(_paths, key);
+    _states.clear(); // the names or the trie changed
+    _known.clear();
+    return _paths++;
+}
+
+bool Xsea::PathFilter::parse(std::istream &is) {
+    Reader reader;
+    reader.open(is);
+    return parse(reader);
+}
+
+bool Xsea::PathFilter::parse(const char *data, std::size_t size) {
+    Reader reader;
+    reader.open(data, size);
+    return parse(reader);
+}
+
+bool Xsea::PathFilter::parseFile(const std::string &fileName) {
+    Reader reader;
+    reader.openFile(fileName);
+    return parse(reader);
+}
+
+bool Xsea::PathFilter::parse(Reader &reader) {
+    if (_states.empty()) {
+        std::vector<std::size_t> none;
+        state(none); // dead
+        std::vector<std::size_t> root(1, 0);
+        state(root); // top
+    }
+    _stack.clear();
+    _stack.push_back(top);
+    bool go = true;
+    while (go && reader.next()) {
+        switch (reader.nodeType()) {
+            case NodeType::_element: {
+                std::uint32_t to = move(_stack.back(), reader.name());
+                if (to == dead) { // no path goes through here
+                    reader.skipSubtree();
+                    break;
+                }
+                for (const std::pair<std::size_t, StringRef> &want : _states[to].attributes) {
+                    for (const Attribute &attr : reader.attributes()) {
+                        if (attr.getKeyRef() == want.second && !(go = _handler.match(want.first, attr.getValueRef())))
+                            break;
+                    }
+                    if (!go)
+                        break;
+                }
+                if (!reader.isEmptyElement())
+                    _stack.push_back(to);
+                break;
+            }
+            case NodeType::_back:
+                _stack.pop_back();
+                break;
+            case NodeType::_text:
+            case NodeType::_cdata:
+                for (std::size_t path : _states[_stack.back()].texts) {
+                    if (!(go = _handler.match(path, reader.value())))
+                        break;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    _error += reader.getError();
+    return reader.good();
+}
+
+std::size_t Xsea::PathFilter::size() const {
+    return _paths;
+}
+
+std::string Xsea::PathFilter::getError() const {
+    return _error;
+}
+
+const char *Xsea::PathFilter::getErrorC() const {
+    return _error.c_str();
+}
+
+std::uint32_t Xsea::PathFilter::state(std::vector<std::size_t> &steps) {
+    std::sort(steps.begin(), steps.end());
+    steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+    auto found = _known.find(steps);
+    if (found != _known.end())
+        return found->second;
+    auto id = static_cast<std::uint32_t>(_states.size());
+    _states.emplace_back();
+    State &made = _states.back();
+    made.steps = steps;
+    made.next.assign(_names.size() + 1, steps.empty() ? dead : unknown); // nothing leaves the dead state
+    for (std::size_t step : steps) {
+        if ((step & 1) != 0) // below the node, no path ends here
+            continue;
+        const Step &node = _trie[step / 2];
+        made.texts.insert(made.texts.end(), node.texts.begin(), node.texts.end());
+        for (const std::pair<std::size_t, std::string> &attribute : node.attributes)
+            made.attributes.emplace_back(attribute.first, StringRef(attribute.second));
+    }
+    _known.emplace(std::move(steps), id);
+    return id;
+}
+
+std::uint32_t Xsea::PathFilter::move(std::uint32_t from, StringRef name) {
+    NameId id = _names.find(name);
+    std::size_t symbol = id == noName ? _names.size() : id;
+    std::uint32_t to = _states[from].next[symbol];
+    if (to != unknown)
+        return to;
+    std::vector<std::size_t> steps;
+    for (std::size_t step : _states[from].steps) {
+        bool below = (step & 1) != 0;
+        const Step &node = _trie[step / 2];
+        for (const Edge &edge : node.edges) {
+            if ((!below || edge.descendant) && (edge.name == noName || edge.name == id))
+                steps.push_back(edge.target * 2);
+        }
+        if (node.loops) // a // step can still start deeper down
+            steps.push_back(step | 1);
+    }
+    to = state(steps);
+    _states[from].next[symbol] = to;
+    return to;
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include "../include/xsea.h"
+
+Xsea::ElementIndex::ElementIndex(Element &top) : _top(top) {
+    _top._store->setIndex(this);
+}
+
+Xsea::ElementIndex::~ElementIndex() {
+    if (_top._store->index() == this)
+        _top._store->setIndex(nullptr);
+}
+
+Xsea::ElementIndex *Xsea::ElementIndex::of(const Node &node) {
+    const Node *top = &node;
+    while (top->_parent != nullptr)
+        top = top->_parent;
+    ElementIndex *index = top->_store->index();
+    return index != nullptr && &index->_top == top ? index : nullptr;
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::ElementIndex::elements(NameId tag) {
+    static const std::vector<ElementHandle> none;
+    if (!_built)
+        build();
+    if (tag >= _byName.size())
+        return none;
+    return byName(tag);
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::ElementIndex::elements(NameId tag, NameId key, StringRef value) {
+    static const std::vector<ElementHandle> none;
+    if (!_built)
+        build();
+    if (tag >= _byName.size() || key == noName)
+        return none;
+    auto found = _byValue.find(std::make_pair(tag, key));
+    if (found == _byValue.end()) { // the first lookup of this tag and key, the tag list is in document order
+        found = _byValue.emplace(std::make_pair(tag, key), Values()).first;
+        const std::vector<ElementHandle> &list = byName(tag);
+        found->second.reserve(list.size());
+        for (ElementHandle elem : list) {
+            const Attribute *attr = elem->findAttribute(key);
+            if (attr != nullptr)
+                bucket(found->second, attr->getValueRef()).push_back(elem);
+        }
+    }
+    auto bucket = found->second.find(value);
+    return bucket == found->second.end() ? none : bucket->second->elements;
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::ElementIndex::elementsIn(NameId ns, NameId local) {
+    static const std::vector<ElementHandle> none;
+    if (!_built)
+        build();
+    if (local == noName)
+        return none;
+    auto found = _byNamespace.find(std::make_pair(ns, local));
+    if (found != _byNamespace.end())
+        return found->second;
+    // the first lookup, gathered from every tag with this local name, one per prefix
+    std::vector<ElementHandle> &list = _byNamespace[std::make_pair(ns, local)];
+    NameTable &names = _top._store->names();
+    for (NameId tag = 0; tag < _byName.size(); tag++) {
+        if (_byName[tag].empty() || names.localOf(tag) != local)
+            continue;
+        std::size_t middle = list.size();
+        for (ElementHandle elem : byName(tag)) {
+            if (elem->_nsId == ns)
+                list.push_back(elem);
+        }
+        std::inplace_merge(list.begin(), list.begin() + static_cast<std::ptrdiff_t>(middle), list.end(),
+                           [](const Node *a, const Node *b) {
+                               return before(a, b);
+                           });
+    }
+    return list;
+}
+
+void Xsea::ElementIndex::attached(Element &elem, bool subtree) {
+    if (!_built)
+        return;
+    add(elem);
+    if (!subtree)
+        return;
+    for (Node *child = elem._first; child != nullptr; child = child->_next) {
+        if (child->_type == NodeType::_element)
+            attached(static_cast<Element &>(*child), true);
+    }
+}
+
+void Xsea::ElementIndex::detaching(Element &elem, bool subtree) {
+    if (!_built)
+        return;
+    remove(elem);
+    if (!subtree)
+        return;
+    for (Node *child = elem._first; child != nullptr; child = child->_next) {
+        if (child->_type == NodeType::_element)
+            detaching(static_cast<Element &>(*child), true);
+    }
+}
+
+void Xsea::ElementIndex::attributesEdited(Element &elem) {
+    auto it = _byValue.lower_bound(std::make_pair(elem._nameId, NameId(0)));
+    while (it != _byValue.end() && it->first.first == elem._nameId)
+        it = _byValue.erase(it);
+    namespacesEdited(elem); // a new declaration may move it
+}
+
+void Xsea::ElementIndex::namespacesEdited(Element &elem) {
+    for (auto ns = _byNamespace.begin(); ns != _byNamespace.end();) {
+        if (ns->first.second == elem._localId)
+            ns = _byNamespace.erase(ns);
+        else
+            ++ns;
+    }
+}
+
+void Xsea::ElementIndex::build() {
+    _byName.clear();
+    _byValue.clear();
+    _byNamespace.clear();
+    _gone.clear();
+    std::vector<Element *> open(1, &_top); // preorder, so every list comes out in document order
+    while (!open.empty()) {
+        Element *elem = open.back();
+        open.pop_back();
+        if (elem != &_top) {
+            if (elem->_nameId >= _byName.size())
+                _byName.resize(elem->_nameId + 1);
+            _byName[elem->_nameId].push_back(elem);
+        }
+        for (Node *child = elem->_last; child != nullptr; child = child->_prev) {
+            if (child->_type == NodeType::_element)
+                open.push_back(static_cast<Element *>(child));
+        }
+    }
+    _built = true;
+}
+
+std::vector<Xsea::ElementHandle> &Xsea::ElementIndex::byName(NameId tag) {
+    std::vector<ElementHandle> &list = _byName[tag];
+    auto gone = _gone.find(tag);
+    if (gone != _gone.end()) { // one pass for every element detached since the last look
+        const std::unordered_set<const Node *> &drop = gone->second;
+        list.erase(std::remove_if(list.begin(), list.end(), [&drop](ElementHandle elem) {
+            return drop.count(elem) != 0;
+        }), list.end());
+        _gone.erase(gone);
+    }
+    return list;
+}
+
+void Xsea::ElementIndex::add(Element &elem) {
+    if (elem._nameId == noName)
+        return;
+    if (elem._nameId >= _byName.size())
+        _byName.resize(elem._nameId + 1);
+    insert(byName(elem._nameId), &elem);
+    auto it = _byValue.lower_bound(std::make_pair(elem._nameId, NameId(0)));
+    for (; it != _byValue.end() && it->first.first == elem._nameId; ++it) {
+        const Attribute *attr = elem.findAttribute(it->first.second);
+        if (attr != nullptr)
+            insert(bucket(it->second, attr->getValueRef()), &elem);
+    }
+    auto ns = _byNamespace.find(std::make_pair(elem._nsId, elem._localId));
+    if (ns != _byNamespace.end())
+        insert(ns->second, &elem);
+}
+
+void Xsea::ElementIndex::remove(Element &elem) {
+    if (elem._nameId >= _byName.size())
+        return;
+    _gone[elem._nameId].insert(&elem); // out of the tag list on its next look, the value lists go now
+    auto it = _byValue.lower_bound(std::make_pair(elem._nameId, NameId(0)));
+    for (; it != _byValue.end() && it->first.first == elem._nameId; ++it) {
+        const Attribute *attr = elem.findAttribute(it->first.second);
+        if (attr == nullptr)
+            continue;
+        auto bucket = it->second.find(attr->getValueRef());
+        if (bucket == it->second.end())
+            continue;
+        std::vector<ElementHandle> &list = bucket->second->elements;
+        list.erase(std::remove(list.begin(), list.end(), &elem), list.end());
+        if (list.empty())
+            it->second.erase(bucket);
+    }
+    auto ns = _byNamespace.find(std::make_pair(elem._nsId, elem._localId));
+    if (ns != _byNamespace.end())
+        ns->second.erase(std::remove(ns->second.begin(), ns->second.end(), &elem), ns->second.end());
+}
+
+void Xsea::ElementIndex::insert(std::vector<ElementHandle> &list, Element *elem) {
+    if (list.empty() || before(list.back(), elem)) { // appends keep the order without a search
+        list.push_back(elem);
+        return;
+    }
+    list.insert(std::upper_bound(list.begin(), list.end(), elem, [](const Node *a, const Node *b) {
+        return before(a, b);
+    }), elem);
+}
+
+bool Xsea::ElementIndex::before(const Node *a, const Node *b) {
+    if (a == b)
+        return false;
+    std::size_t depthA = 0;
+    std::size_t depthB = 0;
+    for (const Node *n = a; n->_parent != nullptr; n = n->_parent)
+        depthA++;
+    for (const Node *n = b; n->_parent != nullptr; n = n->_parent)
+        depthB++;
+    for (; depthA > depthB; depthA--) {
+        a = a->_parent;
+        if (a == b) // b encloses a
+            return false;
+    }
+    for (; depthB > depthA; depthB--) {
+        b = b->_parent;
+        if (b == a)
+            return true;
+    }
+    while (a->_parent != b->_parent) {
+        a = a->_parent;
+        b = b->_parent;
+    }
+    if (a->_parent->_ordered) // the ordinals are current
+        return a->_index < b->_index;
+    // walk out from a both ways rather than renumber, the cost is the distance between the two
+    const Node *next = a->_next;
+    const Node *prev = a->_prev;
+    while (next != b && prev != b && (next != nullptr || prev != nullptr)) {
+        if (next != nullptr)
+            next = next->_next;
+        if (prev != nullptr)
+            prev = prev->_prev;
+    }
+    return next == b;
+}
+
+std::vector<Xsea::ElementHandle> &Xsea::ElementIndex::bucket(Values &values, StringRef value) {
+    auto found = values.find(value);
+    if (found == values.end()) { // the key refers to the copy the bucket owns
+        std::unique_ptr<Bucket> made(new Bucket{value.str(), {}});
+        StringRef key(made->value);
+        found = values.emplace(key, std::move(made)).first;
+    }
+    return found->second->elements;
+}
+
+std::size_t Xsea::ElementIndex::ValueHash::operator()(StringRef value) const {
+    std::size_t h = 14695981039346656037ull; // FNV-1a
+    for (char c : value) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::Document::findAll(StringRef tag) {
+    if (_index == nullptr)
+        _index = std::make_shared<ElementIndex>(*_root);
+    return _index->elements(_store->names().find(tag));
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::Document::findAll(StringRef tag, StringRef key, StringRef value) {
+    if (_index == nullptr)
+        _index = std::make_shared<ElementIndex>(*_root);
+    NameTable &names = _store->names();
+    return _index->elements(names.find(tag), names.find(key), value);
+}
+
+Xsea::ElementHandle Xsea::Document::findFirst(StringRef tag, StringRef key, StringRef value) {
+    const std::vector<ElementHandle> &found = findAll(tag, key, value);
+    return found.empty() ? nullptr : found.front();
+}
+
+const std::vector<Xsea::ElementHandle> &Xsea::Document::findAll(StringRef ns, StringRef local) {
+    static const std::vector<ElementHandle> none;
+    if (_index == nullptr)
+        _index = std::make_shared<ElementIndex>(*_root);
+    NameTable &names = _store->names();
+    NameId nsId = ns.empty() ? noName : names.find(ns);
+    if (!ns.empty() && nsId == noName) // no element can be in it
+        return none;
+    return _index->elementsIn(nsId, names.find(local));
+}
+
+Xsea::ElementHandle Xsea::Document::findFirst(StringRef ns, StringRef local) {
+    const std::vector<ElementHandle> &found = findAll(ns, local);
+    return found.empty() ? nullptr : found.front();
+}
+
+void Xsea::Document::dropIndexes() {
+    _index.reset();
+}
@@ -0,0 +1,71 @@
+#include "../include/xsea.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define XSEA_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <iterator>
+#endif
+
+Xsea::MappedFile::MappedFile(const std::string &fileName) {
+#ifdef XSEA_HAS_MMAP
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st{};
+    if (::fstat(fd, &st) == 0) {
+        _size = static_cast<std::size_t>(st.st_size);
+        if (_size == 0) {
+            _open = true;
+        } else {
+            void *p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                _data = static_cast<const char *>(p);
+                _open = true;
+            } else {
+                _size = 0;
+            }
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream is(fileName, std::ios::binary);
+    if (!is.is_open())
+        return;
+    _fallback.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    _data = _fallback.data();
+    _size = _fallback.size();
+    _open = true;
+#endif
+}
+
+Xsea::MappedFile::~MappedFile() {
+#ifdef XSEA_HAS_MMAP
+    if (_data != nullptr)
+        ::munmap(const_cast<char *>(_data), _size);
+#endif
+}
+
+bool Xsea::MappedFile::isOpen() const {
+    return _open;
+}
+
+const char *Xsea::MappedFile::data() const {
+    return _data;
+}
+
+std::size_t Xsea::MappedFile::size() const {
+    return _size;
+}
+
+void Xsea::MappedFile::adviseSequential(bool sequential) const {
+#ifdef XSEA_HAS_MMAP
+    if (_data != nullptr)
+        ::madvise(const_cast<char *>(_data), _size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+#else
+    (void) sequential;
+#endif
+}
@@ -0,0 +1,93 @@
+#include <cstring>
+#include "../include/xsea.h"
+
+Xsea::NameId Xsea::NameTable::intern(StringRef name) {
+    if (_names.size() * 2 >= _slots.size())
+        grow();
+    std::size_t mask = _slots.size() - 1;
+    for (std::size_t i = hash(name) & mask;; i = (i + 1) & mask) {
+        NameId slot = _slots[i];
+        if (slot == 0) {
+            if (static_cast<std::size_t>(_limit - _cursor) < name.size()) {
+                std::size_t bytes = name.size() > chunkSize ? name.size() : chunkSize;
+                _chunks.emplace_back(new char[bytes]);
+                _cursor = _chunks.back().get();
+                _limit = _cursor + bytes;
+            }
+            if (!name.empty())
+                std::memcpy(_cursor, name.data(), name.size());
+            _names.emplace_back(_cursor, name.size());
+            _cursor += name.size();
+            _slots[i] = static_cast<NameId>(_names.size());
+            return static_cast<NameId>(_names.size() - 1);
+        }
+        if (_names[slot - 1] == name)
+            return slot - 1;
+    }
+}
+
+Xsea::NameId Xsea::NameTable::find(StringRef name) const {
+    if (_slots.empty())
+        return noName;
+    std::size_t mask = _slots.size() - 1;
+    for (std::size_t i = hash(name) & mask;; i = (i + 1) & mask) {
+        NameId slot = _slots[i];
+        if (slot == 0)
+            return noName;
+        if (_names[slot - 1] == name)
+            return slot - 1;
+    }
+}
+
+Xsea::StringRef Xsea::NameTable::name(NameId id) const {
+    return _names[id];
+}
+
+std::size_t Xsea::NameTable::size() const {
+    return _names.size();
+}
+
+Xsea::NameId Xsea::NameTable::prefixOf(NameId id) {
+    return parts(id).first;
+}
+
+Xsea::NameId Xsea::NameTable::localOf(NameId id) {
+    return parts(id).second;
+}
+
+const std::pair<Xsea::NameId, Xsea::NameId> &Xsea::NameTable::parts(NameId id) {
+    if (id < _parts.size() && _parts[id].second != noName)
+        return _parts[id];
+    StringRef name = _names[id]; // the characters stay put while the parts are interned
+    auto colon = name.empty() ? nullptr : static_cast<const char *>(std::memchr(name.data(), ':', name.size()));
+    std::pair<NameId, NameId> split(noName, id);
+    if (colon != nullptr) {
+        split.first = intern(StringRef(name.data(), static_cast<std::size_t>(colon - name.data())));
+        split.second = intern(StringRef(colon + 1, static_cast<std::size_t>(name.end() - colon - 1)));
+    }
+    if (_parts.size() < _names.size())
+        _parts.resize(_names.size(), std::make_pair(noName, noName));
+    _parts[id] = split;
+    return _parts[id];
+}
+
+std::size_t Xsea::NameTable::hash(StringRef name) {
+    std::size_t h = 14695981039346656037ull; // FNV-1a, names are short
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void Xsea::NameTable::grow() {
+    std::vector<NameId> slots(_slots.empty() ? 256 : _slots.size() * 2, 0);
+    std::size_t mask = slots.size() - 1;
+    for (std::size_t id = 0; id < _names.size(); id++) {
+        std::size_t i = hash(_names[id]) & mask;
+        while (slots[i] != 0)
+            i = (i + 1) & mask;
+        slots[i] = static_cast<NameId>(id + 1);
+    }
+    _slots.swap(slots);
+}
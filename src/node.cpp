@@ -3,19 +3,45 @@
 
 
 std::string Xsea::Node::getValue() const {
+    if (_encoded)
+        decode();
+    if (_ref.data() != nullptr)
+        return _ref.str();
     return _value;
 }
 
 const char *Xsea::Node::getValueC() const {
+    if (_encoded)
+        decode();
+    if (_ref.data() != nullptr) { // the buffer is not null terminated
+        _value = _ref.str();
+        _ref = StringRef();
+    }
     return _value.c_str();
 }
 
+Xsea::StringRef Xsea::Node::getValueRef() const {
+    if (_encoded)
+        decode();
+    if (_ref.data() != nullptr)
+        return _ref;
+    return StringRef(_value);
+}
+
 const Xsea::ElementPtr Xsea::Node::getParentPtr() const {
-    return _parent.lock();
+    if (_parent == nullptr)
+        return nullptr;
+    return std::static_pointer_cast<Element>(_parent->shared_from_this());
 }
 
 Xsea::ElementPtr Xsea::Node::getParentPtr() {
-    return _parent.lock();
+    if (_parent == nullptr)
+        return nullptr;
+    return std::static_pointer_cast<Element>(_parent->shared_from_this());
+}
+
+Xsea::ElementHandle Xsea::Node::parentHandle() const {
+    return _parent;
 }
 
 Xsea::NodeType Xsea::Node::getType() const {
@@ -23,68 +49,100 @@ Xsea::NodeType Xsea::Node::getType() const {
 }
 
 const Xsea::NodePtr Xsea::Node::previousPtr() const {
-    return _parent.lock()->ptrAt(_index - 1);
+    return _prev == nullptr ? nullptr : _prev->_link;
 }
 
 Xsea::NodePtr Xsea::Node::previousPtr() {
-    return _parent.lock()->ptrAt(_index + 1);
+    return _prev == nullptr ? nullptr : _prev->_link;
+}
+
+Xsea::NodeHandle Xsea::Node::previousHandle() const {
+    return _prev;
 }
 
 const Xsea::NodePtr Xsea::Node::nextPtr() const {
-    return _parent.lock()->ptrAt(_index + 1);
+    return _next == nullptr ? nullptr : _next->_link;
 }
 
 Xsea::NodePtr Xsea::Node::nextPtr() {
-    return _parent.lock()->ptrAt(_index + 1);
+    return _next == nullptr ? nullptr : _next->_link;
+}
+
+Xsea::NodeHandle Xsea::Node::nextHandle() const {
+    return nextOf(this);
+}
+
+Xsea::NodeRange<Xsea::Node> Xsea::Node::siblings() const {
+    return NodeRange<Node>(nextOf(this), &Node::nextOf);
+}
+
+Xsea::NodeRange<Xsea::Element> Xsea::Node::ancestors() const {
+    return NodeRange<Element>(ancestorOf(this), [](const Element *elem) { return ancestorOf(elem); });
 }
 
 bool Xsea::Node::isRoot() const {
-    return _parent.lock()->_value.empty();
+    return _parent != nullptr && _parent->getValueRef().empty();
 }
 
 void Xsea::Node::setValue(const std::string &txt) {
+    if (_type == NodeType::_element) { // the index files it under the new name
+        auto &elem = static_cast<Element &>(*this);
+        ElementIndex *index = ElementIndex::of(elem);
+        if (index != nullptr)
+            index->detaching(elem, false);
+        elem.rename(txt);
+        if (index != nullptr)
+            index->attached(elem, false);
+        return;
+    }
     _value = txt;
+    _ref = StringRef();
+    _encoded = false;
 }
 
 void Xsea::Node::setValue(const char *txt) {
-    _value = txt;
+    setValue(std::string(txt));
 }
 
 void Xsea::Node::clear() {
     _value.clear();
+    _ref = StringRef();
+    _encoded = false;
 }
 
-Xsea::Node::Node(Xsea::ElementPtr parent, std::size_t index, const std::string &value):
-     _parent(parent), _index(index), _value(value) { }
+Xsea::Node::Node(Xsea::Element *parent, std::size_t index, const std::string &value):
+     _value(value), _parent(parent), _index(index) { }
 
-Xsea::Node::Node(Xsea::ElementPtr parent, std::size_t index):
+Xsea::Node::Node(Xsea::Element *parent, std::size_t index):
      _parent(parent), _index(index) { }
 
 const Xsea::Element &Xsea::Node::getParent() const {
-    return *_parent.lock();
+    return *_parent;
 }
 
 Xsea::Element &Xsea::Node::getParent() {
-    return *_parent.lock();
+    return *_parent;
 }
 
 const Xsea::Node &Xsea::Node::previous() const {
-    return *(_parent.lock()->_children[_index - 1]);
+    return *_prev;
 }
 
 Xsea::Node &Xsea::Node::previous() {
-    return *(_parent.lock()->_children[_index - 1]);
+    return *_prev;
 }
 
 const Xsea::Node &Xsea::Node::next() const {
-    return *(_parent.lock()->_children[_index + 1]);
+    return *_next;
 }
 
 Xsea::Node &Xsea::Node::next() {
-    return *(_parent.lock()->_children[_index + 1]);
+    return *_next;
 }
 
 std::size_t Xsea::Node::index() const {
+    if (_parent != nullptr && !_parent->_ordered) // numbered again after an insert or remove in the middle
+        _parent->renumber();
     return _index;
 }
 
@@ -92,15 +150,67 @@ Xsea::NodePtr Xsea::Node::getThisPtr() {
     return shared_from_this();
 }
 
-Xsea::NodePtr Xsea::Node::shared_from_this() {
-    return _parent.lock()->_children[_index];
-}
-
-const Xsea::NodePtr Xsea::Node::shared_from_this() const {
-    return _parent.lock()->_children[_index];
+Xsea::NodePtr Xsea::Node::deepClone() const {
+    NodeStorePtr store = _store->shared_from_this();
+    NodePtr copy;
+    switch (_type) {
+        case NodeType::_declaration:
+            copy = NodeStore::make<Declaration>(store, nullptr, 0);
+            break;
+        case NodeType::_element: {
+            ElementPtr elemPtr = NodeStore::make<Element>(store, nullptr, 0);
+            auto &from = static_cast<const Element &>(*this);
+            elemPtr->_nameId = from._nameId;
+            elemPtr->_nsId = from._nsId;
+            elemPtr->_localId = from._localId;
+            elemPtr->_attributes = from._attributes; // the names are shared, owned values are copied
+            elemPtr->_attributesDirty = from._attributesDirty;
+            elemPtr->_declaredDirty = from._declaredDirty;
+            for (const Node *child = from._first; child != nullptr; child = child->_next)
+                elemPtr->linkBefore(nullptr, child->deepClone());
+            copy = elemPtr;
+            break;
+        }
+        case NodeType::_text:
+            copy = NodeStore::make<Text>(store, nullptr, 0);
+            break;
+        case NodeType::_comment:
+            copy = NodeStore::make<Comment>(store, nullptr, 0);
+            break;
+        case NodeType::_unknown:
+            copy = NodeStore::make<Unknown>(store, nullptr, 0);
+            break;
+        case NodeType::_cdata:
+            copy = NodeStore::make<CData>(store, nullptr, 0);
+            break;
+        case NodeType::_instruction:
+            copy = NodeStore::make<ProcessingInstruction>(store, nullptr, 0);
+            break;
+        case NodeType::_doctype:
+            copy = NodeStore::make<DocType>(store, nullptr, 0);
+            break;
+        default:
+            return nullptr;
+    }
+    copy->_value = _value; // an in-situ value stays a view, the store keeps its input alive
+    copy->_ref = _ref;
+    copy->_encoded = _encoded;
+    return copy;
+}
+
+void Xsea::Node::decode() const {
+    decodeEntities(_ref, _value);
+    _ref = StringRef();
+    _encoded = false;
+}
+
+Xsea::Node *Xsea::Node::nextOf(const Node *node) {
+    return node->_next;
+}
+
+Xsea::Element *Xsea::Node::ancestorOf(const Node *node) {
+    Element *parent = node->_parent;
+    if (parent == nullptr || (parent->_parent == nullptr && parent->getValueRef().empty())) // the Document's own
+        return nullptr;
+    return parent;
 }
-
-
-
-
-
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "../include/xsea.h"
+
+Xsea::NodeStore::NodeStore(NameTablePtr names) : _names(std::move(names)) {}
+
+Xsea::NodeStore::~NodeStore() {
+    for (char *block : _blocks)
+        std::free(block);
+}
+
+void *Xsea::NodeStore::allocate(std::size_t size) {
+    size = (size + granule - 1) / granule * granule;
+    std::size_t cls = size / granule;
+    if (cls < classes && _free[cls] != nullptr) { // reuse a node of the same size
+        void *p = _free[cls];
+        _free[cls] = *static_cast<void **>(p);
+        return p;
+    }
+    if (static_cast<std::size_t>(_limit - _cursor) < size) {
+        std::size_t bytes = size > blockSize ? size : blockSize;
+        auto block = static_cast<char *>(std::malloc(bytes));
+        if (block == nullptr)
+            throw std::bad_alloc();
+        _blocks.push_back(block);
+        _cursor = block;
+        _limit = block + bytes;
+    }
+    void *p = _cursor;
+    _cursor += size;
+    return p;
+}
+
+void Xsea::NodeStore::deallocate(void *p, std::size_t size) {
+    size = (size + granule - 1) / granule * granule;
+    std::size_t cls = size / granule;
+    if (cls >= classes) // big leftovers go back with the block
+        return;
+    *static_cast<void **>(p) = _free[cls];
+    _free[cls] = p;
+}
+
+void Xsea::NodeStore::retain(std::shared_ptr<void> input) {
+    _inputs.push_back(std::move(input));
+}
+
+Xsea::StringRef Xsea::NodeStore::keep(StringRef text) {
+    if (text.empty())
+        return StringRef("", 0);
+    if (static_cast<std::size_t>(_textLimit - _textCursor) < text.size()) {
+        std::size_t bytes = text.size() > blockSize / 4 ? text.size() : blockSize;
+        auto block = static_cast<char *>(std::malloc(bytes));
+        if (block == nullptr)
+            throw std::bad_alloc();
+        _blocks.push_back(block);
+        if (bytes != blockSize) // a big text gets a block of its own, keep packing into the current one
+            return StringRef(static_cast<const char *>(std::memcpy(block, text.data(), text.size())), text.size());
+        _textCursor = block;
+        _textLimit = block + bytes;
+    }
+    char *p = _textCursor;
+    std::memcpy(p, text.data(), text.size());
+    _textCursor += text.size();
+    return StringRef(p, text.size());
+}
+
+Xsea::NameTable &Xsea::NodeStore::names() {
+    return *_names;
+}
+
+Xsea::ElementIndex *Xsea::NodeStore::index() const {
+    return _index;
+}
+
+void Xsea::NodeStore::setIndex(ElementIndex *index) {
+    _index = index;
+}
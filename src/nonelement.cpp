@@ -4,48 +4,75 @@ bool Xsea::Nonelement::hasChildren() const {
     return false;
 }
 
-Xsea::Nonelement::Nonelement(Xsea::ElementPtr p, std::size_t index) : Node(p, index) {
+Xsea::Nonelement::Nonelement(Xsea::Element *p, std::size_t index) : Node(p, index) {
     _type = NodeType::_nonelement;
 }
 
-Xsea::Nonelement::Nonelement(Xsea::ElementPtr p, std::size_t index, const std::string &value) :
+Xsea::Nonelement::Nonelement(Xsea::Element *p, std::size_t index, const std::string &value) :
         Node(p, index, value) {
     _type = NodeType::_nonelement;
 }
 
-Xsea::Text::Text(Xsea::ElementPtr p, std::size_t index) : Nonelement(p, index) {
+Xsea::Text::Text(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
     _type = NodeType::_text;
 }
 
-Xsea::Text::Text(Xsea::ElementPtr p, std::size_t index, const std::string &value) :
+Xsea::Text::Text(Xsea::Element *p, std::size_t index, const std::string &value) :
         Nonelement(p, index, value) {
     _type = NodeType ::_text;
 }
 
-Xsea::Declaration::Declaration(Xsea::ElementPtr p, std::size_t index) : Nonelement(p, index) {
+Xsea::Declaration::Declaration(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
     _type = NodeType::_declaration;
 }
 
-Xsea::Declaration::Declaration(Xsea::ElementPtr p, std::size_t index, const std::string &value)
+Xsea::Declaration::Declaration(Xsea::Element *p, std::size_t index, const std::string &value)
         : Nonelement(p, index, value) {
     _type = NodeType::_declaration;
 }
 
 
-Xsea::Comment::Comment(Xsea::ElementPtr p, std::size_t index) : Nonelement(p, index) {
+Xsea::Comment::Comment(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
     _type = NodeType::_comment;
 }
 
-Xsea::Comment::Comment(Xsea::ElementPtr p, std::size_t index, const std::string &value)
+Xsea::Comment::Comment(Xsea::Element *p, std::size_t index, const std::string &value)
         : Nonelement(p, index, value) {
     _type = NodeType::_comment;
 }
 
-Xsea::Unknown::Unknown(Xsea::ElementPtr p, std::size_t index) : Nonelement(p, index) {
+Xsea::Unknown::Unknown(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
     _type = NodeType::_unknown;
 }
 
-Xsea::Unknown::Unknown(Xsea::ElementPtr p, std::size_t index, const std::string &value)
+Xsea::Unknown::Unknown(Xsea::Element *p, std::size_t index, const std::string &value)
         : Nonelement(p, index, value) {
     _type = NodeType::_unknown;
 }
+
+Xsea::CData::CData(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
+    _type = NodeType::_cdata;
+}
+
+Xsea::CData::CData(Xsea::Element *p, std::size_t index, const std::string &value)
+        : Nonelement(p, index, value) {
+    _type = NodeType::_cdata;
+}
+
+Xsea::ProcessingInstruction::ProcessingInstruction(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
+    _type = NodeType::_instruction;
+}
+
+Xsea::ProcessingInstruction::ProcessingInstruction(Xsea::Element *p, std::size_t index, const std::string &value)
+        : Nonelement(p, index, value) {
+    _type = NodeType::_instruction;
+}
+
+Xsea::DocType::DocType(Xsea::Element *p, std::size_t index) : Nonelement(p, index) {
+    _type = NodeType::_doctype;
+}
+
+Xsea::DocType::DocType(Xsea::Element *p, std::size_t index, const std::string &value)
+        : Nonelement(p, index, value) {
+    _type = NodeType::_doctype;
+}
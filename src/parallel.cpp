@@ -0,0 +1,154 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "../include/xsea.h"
+
+namespace {
+
+// tokens of one slice of the input, starting at a '<' that is hopefully a token boundary
+struct Chunk {
+    const char *start = nullptr;
+    const char *limit = nullptr; // start of the next chunk
+    const char *stop = nullptr; // where the tokenizer really stopped, at or after limit
+    std::vector<Xsea::Token> tokens;
+    std::string error;
+    bool ready = false;
+};
+
+// tokenize [start, limit), the last token may run past limit
+void tokenize(Chunk &chunk, const char *end) {
+    Xsea::Tokenizer tokenizer;
+    tokenizer.setInput(chunk.start, end, true);
+    Xsea::Token token;
+    while (tokenizer.position() < chunk.limit) {
+        Xsea::Tokenizer::Status status = tokenizer.next(token);
+        if (status == Xsea::Tokenizer::Status::_token) {
+            chunk.tokens.push_back(token);
+        } else {
+            if (status == Xsea::Tokenizer::Status::_error)
+                chunk.error = tokenizer.getError();
+            break;
+        }
+    }
+    chunk.stop = tokenizer.position();
+}
+
+// the workers and what they share with the builder
+// the destructor lets them run out and joins them on every way out, a throwing handler included
+struct Crew {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::size_t consumed = 0; // chunks handed to the reader
+    std::atomic<std::size_t> taken{0}; // chunks handed to a worker
+    bool stopped = false; // the workers take nothing more
+    std::vector<std::thread> workers;
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        changed.notify_all();
+    }
+
+    ~Crew() {
+        stop();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+};
+
+}
+
+const std::size_t Xsea::SaxParser::parallelRetries;
+
+bool Xsea::SaxParser::parseParallel(const char *data, std::size_t size, unsigned threads) {
+    if (threads < 2 || size < 2 * parallelChunk)
+        return parse(data, size);
+    _error.clear();
+    const char *begin = data, *end = data + size;
+
+    // split at the first '<' after every parallelChunk bytes
+    std::vector<Chunk> chunks(1);
+    chunks[0].start = begin;
+    for (const char *p = begin + parallelChunk; p < end; p += parallelChunk) {
+        auto lt = static_cast<const char *>(std::memchr(p, '<', static_cast<std::size_t>(end - p)));
+        if (lt == nullptr)
+            break;
+        chunks.back().limit = lt;
+        chunks.emplace_back();
+        chunks.back().start = lt;
+        p = lt;
+    }
+    chunks.back().limit = end;
+
+    // workers tokenize ahead, at most a few chunks per thread are held at once
+    std::size_t window = threads * 4;
+    Crew crew; // after chunks, so the workers are joined before the chunks go
+    for (unsigned t = 0; t < threads; t++) {
+        crew.workers.emplace_back([&]() {
+            while (true) {
+                std::size_t i = crew.taken++;
+                if (i >= chunks.size())
+                    return;
+                {
+                    std::unique_lock<std::mutex> lock(crew.mutex);
+                    crew.changed.wait(lock, [&]() { return crew.stopped || i < crew.consumed + window; });
+                    if (crew.stopped)
+                        return;
+                }
+                tokenize(chunks[i], end);
+                std::lock_guard<std::mutex> lock(crew.mutex);
+                chunks[i].ready = true;
+                crew.changed.notify_all();
+            }
+        });
+    }
+
+    // build in order, a chunk whose start was not a token boundary is tokenized again from the real one
+    // after parallelRetries of those the splits keep landing inside markup, the rest is tokenized here
+    Reader reader;
+    reader.setWhitespace(_whitespace);
+    const char *pos = begin;
+    bool ok = true;
+    bool serial = false;
+    std::size_t retries = 0;
+    _stopped = false;
+    for (std::size_t i = 0; i < chunks.size() && ok && !_stopped; i++) {
+        if (!serial) {
+            std::unique_lock<std::mutex> lock(crew.mutex);
+            crew.changed.wait(lock, [&]() { return chunks[i].ready; });
+        }
+        Chunk again; // from the real boundary, a worker may still be busy with chunks[i] once serial
+        Chunk *chunk = &chunks[i];
+        if (serial || chunk->start != pos) {
+            again.start = pos;
+            again.limit = chunk->limit;
+            again.stop = pos;
+            if (pos < chunk->limit) // or the previous chunk already ran through this one
+                tokenize(again, end);
+            if (!serial && pos < chunk->limit && ++retries == parallelRetries) {
+                serial = true;
+                crew.stop();
+            }
+            if (!serial)
+                std::vector<Token>().swap(chunk->tokens);
+            chunk = &again;
+        }
+        bool last = i + 1 == chunks.size() && chunk->error.empty();
+        reader.replay(chunk->tokens.data(), chunk->tokens.data() + chunk->tokens.size(), last);
+        ok = parse(reader);
+        if (ok && !chunk->error.empty()) {
+            _error = chunk->error;
+            ok = false;
+        }
+        pos = chunk->stop;
+        std::vector<Token>().swap(chunk->tokens);
+        if (!serial) {
+            std::lock_guard<std::mutex> lock(crew.mutex);
+            crew.consumed = i + 1;
+            crew.changed.notify_all();
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include "../include/xsea.h"
+
+namespace {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v';
+}
+
+inline bool isText(const Xsea::Node &node) { // text() takes CDATA sections too
+    return node.getType() == Xsea::NodeType::_text || node.getType() == Xsea::NodeType::_cdata;
+}
+
+inline bool isNameChar(char c) {
+    return !isSpace(c) && std::strchr("/[]@=!'\"()*", c) == nullptr;
+}
+
+void skipSpaces(const char *&p, const char *end) {
+    while (p < end && isSpace(*p))
+        p++;
+}
+
+bool skipWord(const char *&p, const char *end, const char *word) { // the word and nothing else
+    std::size_t size = std::strlen(word);
+    if (static_cast<std::size_t>(end - p) < size || std::memcmp(p, word, size) != 0 ||
+        (p + size < end && isNameChar(p[size]) && isNameChar(word[size - 1])))
+        return false;
+    p += size;
+    return true;
+}
+
+Xsea::StringRef readName(const char *&p, const char *end) {
+    const char *begin = p;
+    while (p < end && isNameChar(*p))
+        p++;
+    return Xsea::StringRef(begin, static_cast<std::size_t>(p - begin));
+}
+
+bool readLiteral(const char *&p, const char *end, std::string &out) {
+    if (p == end || (*p != '\'' && *p != '"'))
+        return false;
+    auto close = static_cast<const char *>(std::memchr(p + 1, *p, static_cast<std::size_t>(end - p - 1)));
+    if (close == nullptr)
+        return false;
+    out.assign(p + 1, close);
+    p = close + 1;
+    return true;
+}
+
+// keep the first of every node reached more than once, in the order they were found
+void dropRepeats(std::vector<Xsea::NodeHandle> &out, std::size_t begin) {
+    std::vector<std::pair<Xsea::NodeHandle, std::size_t>> seen;
+    seen.reserve(out.size() - begin);
+    for (std::size_t i = begin; i < out.size(); i++)
+        seen.emplace_back(out[i], i);
+    std::sort(seen.begin(), seen.end());
+    std::vector<bool> repeat(out.size() - begin);
+    for (std::size_t i = 1; i < seen.size(); i++) {
+        if (seen[i].first == seen[i - 1].first)
+            repeat[seen[i].second - begin] = true;
+    }
+    std::size_t kept = begin;
+    for (std::size_t i = begin; i < out.size(); i++) {
+        if (!repeat[i - begin])
+            out[kept++] = out[i];
+    }
+    out.resize(kept);
+}
+
+}
+
+class Xsea::Query::Run {
+public:
+    Run(const Query &query, NameTable &names, std::vector<NodeHandle> *out) :
+            _query(query), _ids(query._names.size()), _out(out) {
+        for (std::size_t i = 0; i < _ids.size(); i++)
+            _ids[i] = names.find(query._names[i]);
+    }
+
+    void from(Node &context) {
+        step(0, context);
+    }
+
+    NodeHandle found() const {
+        return _found;
+    }
+
+    // put out[begin..] in document order and drop the repeats, with one walk of the subtree of top
+    static void order(std::vector<NodeHandle> &out, std::size_t begin, Node &top) {
+        std::unordered_set<NodeHandle> left(out.begin() + static_cast<std::ptrdiff_t>(begin), out.end());
+        out.resize(begin);
+        Node *node = &top;
+        while (!left.empty()) {
+            if (left.erase(node) != 0)
+                out.push_back(node);
+            if (node->_type == NodeType::_element && static_cast<Element *>(node)->_first != nullptr) {
+                node = static_cast<Element *>(node)->_first;
+                continue;
+            }
+            while (node != &top && node->_next == nullptr)
+                node = node->_parent;
+            if (node == &top)
+                break;
+            node = node->_next;
+        }
+    }
+
+private:
+    const Query &_query;
+    std::vector<NameId> _ids; // by slot, noName for names this NameTable has never seen
+    std::vector<NodeHandle> *_out; // nullptr to stop at the first match
+    NodeHandle _found = nullptr;
+
+    bool emit(Node &node) { // false to stop
+        if (_out == nullptr) {
+            _found = &node;
+            return false;
+        }
+        _out->push_back(&node);
+        return true;
+    }
+
+    bool step(std::size_t k, Node &node) {
+        if (k == _query._steps.size())
+            return emit(node);
+        const Step &s = _query._steps[k];
+        switch (s.axis) {
+            case Axis::_self:
+                return step(k + 1, node);
+            case Axis::_attribute:
+                if (attribute(node, s.name) == nullptr)
+                    return true;
+                return step(k + 1, node);
+            case Axis::_child:
+            case Axis::_descendant:
+                if (node._type != NodeType::_element)
+                    return true;
+                return children(k, static_cast<Element &>(node), s.axis == Axis::_descendant);
+        }
+        return true;
+    }
+
+    // the children that pass step k, with descend their descendants too, each one taken through
+    // the later steps before its descendants are tried, so with steps after a // the matches nest
+    // out of document order and select puts them back
+    bool children(std::size_t k, Element &parent, bool descend) {
+        const Step &s = _query._steps[k];
+        if (!descend && (s.test == Test::_name || s.test == Test::_expanded) && _ids[s.name] == noName)
+            return true;
+        std::size_t totals[maxPredicates];
+        std::size_t counts[maxPredicates] = {};
+        count(s, parent, totals);
+        for (Node *child = parent._first; child != nullptr; child = child->_next) {
+            if (matches(s, *child) && accepts(s, *child, s.predicates.size(), counts, totals) && !step(k + 1, *child))
+                return false;
+            if (descend && child->_type == NodeType::_element &&
+                !children(k, static_cast<Element &>(*child), true))
+                return false;
+        }
+        return true;
+    }
+
+    // for each [last()], how many children pass the predicates in front of it
+    void count(const Step &s, const Element &parent, std::size_t *totals) const {
+        for (std::size_t i = 0; i < s.predicates.size(); i++) {
+            if (s.predicates[i].kind != Predicate::Kind::_last)
+                continue;
+            std::size_t counts[maxPredicates] = {};
+            totals[i] = 0;
+            for (const Node *child = parent._first; child != nullptr; child = child->_next) {
+                if (matches(s, *child) && accepts(s, *child, i, counts, totals))
+                    totals[i]++;
+            }
+        }
+    }
+
+    bool matches(const Step &s, const Node &node) const {
+        switch (s.test) {
+            case Test::_name:
+                return node._type == NodeType::_element && _ids[s.name] != noName &&
+                       static_cast<const Element &>(node)._nameId == _ids[s.name];
+            case Test::_expanded: {
+                if (node._type != NodeType::_element || _ids[s.name] == noName)
+                    return false;
+                bool none = _query._names[s.ns].empty(); // {} is no namespace, which has no id
+                if (!none && _ids[s.ns] == noName)
+                    return false;
+                const auto &elem = static_cast<const Element &>(node);
+                return elem._localId == _ids[s.name] && elem._nsId == (none ? noName : _ids[s.ns]);
+            }
+            case Test::_any:
+                return node._type == NodeType::_element;
+            case Test::_text:
+                return isText(node);
+        }
+        return false;
+    }
+
+    bool accepts(const Step &s, const Node &node, std::size_t upTo, std::size_t *counts,
+                 const std::size_t *totals) const {
+        for (std::size_t i = 0; i < upTo; i++) {
+            const Predicate &p = s.predicates[i];
+            switch (p.kind) {
+                case Predicate::Kind::_position:
+                    if (++counts[i] != p.position)
+                        return false;
+                    break;
+                case Predicate::Kind::_last:
+                    if (++counts[i] != totals[i])
+                        return false;
+                    break;
+                case Predicate::Kind::_has:
+                    if (attribute(node, p.name) == nullptr)
+                        return false;
+                    break;
+                case Predicate::Kind::_equal:
+                case Predicate::Kind::_notEqual: { // both are false without the attribute
+                    const Attribute *attr = attribute(node, p.name);
+                    if (attr == nullptr ||
+                        (attr->getValueRef() == StringRef(p.value)) != (p.kind == Predicate::Kind::_equal))
+                        return false;
+                    break;
+                }
+                case Predicate::Kind::_textEqual:
+                    if (!hasText(node, p.value))
+                        return false;
+                    break;
+            }
+        }
+        return true;
+    }
+
+    const Attribute *attribute(const Node &node, std::size_t name) const {
+        if (node._type != NodeType::_element || _ids[name] == noName)
+            return nullptr;
+        return static_cast<const Element &>(node).findAttribute(_ids[name]);
+    }
+
+    static bool hasText(const Node &node, const std::string &value) {
+        if (node._type != NodeType::_element)
+            return false;
+        for (const Node *child = static_cast<const Element &>(node)._first; child != nullptr; child = child->_next) {
+            if (isText(*child) && child->getValueRef() == StringRef(value))
+                return true;
+        }
+        return false;
+    }
+};
+
+Xsea::Query::Query(const std::string &expression) {
+    compile(expression);
+}
+
+bool Xsea::Query::compile(const std::string &expression) {
+    _steps.clear();
+    _names.clear();
+    _absolute = false;
+    _overlapping = false;
+    _unordered = false;
+    _error.clear();
+    const char *p = expression.data();
+    const char *end = p + expression.size();
+    Axis axis = Axis::_child;
+    skipSpaces(p, end);
+    if (p < end && *p == '/') {
+        _absolute = true;
+        p++;
+        if (p < end && *p == '/') {
+            axis = Axis::_descendant;
+            p++;
+        }
+    }
+    while (true) {
+        skipSpaces(p, end);
+        if (p == end)
+            return fail("Missing step at the end of " + expression + '\n');
+        Step step{axis, Test::_any, 0, 0, {}};
+        if (*p == '@') {
+            p++;
+            StringRef name = readName(p, end);
+            if (name.empty() || axis == Axis::_descendant)
+                return fail("Bad attribute step in " + expression + '\n');
+            step.axis = Axis::_attribute;
+            step.name = slot(name);
+        } else if (*p == '*') {
+            p++;
+        } else if (skipWord(p, end, "..")) {
+            return fail("Parent steps are not supported in " + expression + '\n');
+        } else if (skipWord(p, end, ".")) {
+            if (axis == Axis::_descendant)
+                return fail("Bad self step in " + expression + '\n');
+            step.axis = Axis::_self;
+        } else if (skipWord(p, end, "text()")) {
+            step.test = Test::_text;
+        } else if (*p == '{') {
+            auto close = static_cast<const char *>(std::memchr(p, '}', static_cast<std::size_t>(end - p)));
+            if (close == nullptr)
+                return fail("Missing } in " + expression + '\n');
+            StringRef ns(p + 1, static_cast<std::size_t>(close - p - 1));
+            p = close + 1;
+            StringRef name = readName(p, end);
+            if (name.empty())
+                return fail("Missing local name in " + expression + '\n');
+            step.test = Test::_expanded;
+            step.ns = slot(ns);
+            step.name = slot(name);
+        } else {
+            StringRef name = readName(p, end);
+            if (name.empty())
+                return fail("Unexpected '" + std::string(1, *p) + "' in " + expression + '\n');
+            step.test = Test::_name;
+            step.name = slot(name);
+        }
+        skipSpaces(p, end);
+        while (p < end && *p == '[') {
+            if (step.axis == Axis::_attribute || step.axis == Axis::_self)
+                return fail("Predicates must follow a child step in " + expression + '\n');
+            if (step.predicates.size() == maxPredicates)
+                return fail("Too many predicates in " + expression + '\n');
+            p++;
+            skipSpaces(p, end);
+            Predicate pred{Predicate::Kind::_position, 0, 0, std::string()};
+            if (p < end && *p >= '0' && *p <= '9') {
+                while (p < end && *p >= '0' && *p <= '9')
+                    pred.position = pred.position * 10 + static_cast<std::size_t>(*p++ - '0');
+                if (pred.position == 0)
+                    return fail("Positions start at 1 in " + expression + '\n');
+            } else if (skipWord(p, end, "last()")) {
+                pred.kind = Predicate::Kind::_last;
+            } else if (p < end && *p == '@') {
+                p++;
+                StringRef name = readName(p, end);
+                if (name.empty())
+                    return fail("Missing attribute name in " + expression + '\n');
+                pred.name = slot(name);
+                pred.kind = Predicate::Kind::_has;
+                skipSpaces(p, end);
+                if (skipWord(p, end, "="))
+                    pred.kind = Predicate::Kind::_equal;
+                else if (skipWord(p, end, "!="))
+                    pred.kind = Predicate::Kind::_notEqual;
+                skipSpaces(p, end);
+                if (pred.kind != Predicate::Kind::_has && !readLiteral(p, end, pred.value))
+                    return fail("Missing quoted value in " + expression + '\n');
+            } else if (skipWord(p, end, "text()")) {
+                pred.kind = Predicate::Kind::_textEqual;
+                skipSpaces(p, end);
+                if (!skipWord(p, end, "="))
+                    return fail("Expected text()='value' in " + expression + '\n');
+                skipSpaces(p, end);
+                if (!readLiteral(p, end, pred.value))
+                    return fail("Missing quoted value in " + expression + '\n');
+            } else {
+                return fail("Unsupported predicate in " + expression + '\n');
+            }
+            skipSpaces(p, end);
+            if (p == end || *p != ']')
+                return fail("Unclosed predicate in " + expression + '\n');
+            p++;
+            skipSpaces(p, end);
+            step.predicates.push_back(std::move(pred));
+        }
+        bool last = step.axis == Axis::_attribute || step.test == Test::_text;
+        _steps.push_back(std::move(step));
+        if (p == end)
+            break;
+        if (*p != '/')
+            return fail("Unexpected '" + std::string(1, *p) + "' in " + expression + '\n');
+        if (last)
+            return fail("Nothing may follow @key or text() in " + expression + '\n');
+        p++;
+        axis = Axis::_child;
+        if (p < end && *p == '/') {
+            axis = Axis::_descendant;
+            p++;
+        }
+    }
+    bool many = false; // whether the step may run from more than one context
+    bool nested = false; // whether the contexts may be inside each other
+    for (const Step &step : _steps) {
+        if (step.axis == Axis::_child || step.axis == Axis::_descendant) {
+            if (nested)
+                _unordered = true;
+            if (step.axis == Axis::_descendant && many)
+                _overlapping = true;
+            many = true;
+        }
+        if (step.axis == Axis::_descendant)
+            nested = true;
+    }
+    return true;
+}
+
+std::size_t Xsea::Query::select(const Document &doc, std::vector<NodeHandle> &out) const {
+    return select(*doc._root, out);
+}
+
+std::size_t Xsea::Query::select(const Element &context, std::vector<NodeHandle> &out) const {
+    if (!good() || _steps.empty())
+        return 0;
+    const Element *start = &context;
+    while (_absolute && start->_parent != nullptr)
+        start = start->_parent;
+    std::size_t begin = out.size();
+    Run run(*this, context._store->names(), &out);
+    run.from(const_cast<Element &>(*start));
+    if (_unordered)
+        Run::order(out, begin, const_cast<Element &>(*start));
+    else if (_overlapping)
+        dropRepeats(out, begin);
+    return out.size() - begin;
+}
+
+Xsea::NodeHandle Xsea::Query::first(const Document &doc) const {
+    return first(*doc._root);
+}
+
+Xsea::NodeHandle Xsea::Query::first(const Element &context) const {
+    if (!good() || _steps.empty())
+        return nullptr;
+    const Element *start = &context;
+    while (_absolute && start->_parent != nullptr)
+        start = start->_parent;
+    if (_unordered) { // the first one found need not be the first in the document
+        std::vector<NodeHandle> out;
+        return select(context, out) == 0 ? nullptr : out.front();
+    }
+    Run run(*this, context._store->names(), nullptr);
+    run.from(const_cast<Element &>(*start));
+    return run.found();
+}
+
+std::size_t Xsea::Query::values(const Document &doc, std::vector<StringRef> &out) const {
+    return values(*doc._root, out);
+}
+
+std::size_t Xsea::Query::values(const Element &context, std::vector<StringRef> &out) const {
+    std::vector<NodeHandle> nodes;
+    select(context, nodes);
+    const Step *last = _steps.empty() ? nullptr : &_steps.back();
+    NameId key = last != nullptr && last->axis == Axis::_attribute ? context._store->names().find(_names[last->name])
+                                                                   : noName;
+    for (NodeHandle node : nodes) {
+        if (key != noName) {
+            out.push_back(static_cast<Element *>(node)->findAttribute(key)->getValueRef());
+        } else if (node->_type == NodeType::_element) { // the first text inside
+            StringRef text;
+            for (const Node *child = static_cast<Element *>(node)->_first; child != nullptr; child = child->_next) {
+                if (isText(*child)) {
+                    text = child->getValueRef();
+                    break;
+                }
+            }
+            out.push_back(text);
+        } else {
+            out.push_back(node->getValueRef());
+        }
+    }
+    return nodes.size();
+}
+
+bool Xsea::Query::good() const {
+    return _error.empty();
+}
+
+std::string Xsea::Query::getError() const {
+    return _error;
+}
+
+std::size_t Xsea::Query::slot(StringRef name) {
+    for (std::size_t i = 0; i < _names.size(); i++) {
+        if (StringRef(_names[i]) == name)
+            return i;
+    }
+    _names.push_back(name.str());
+    return _names.size() - 1;
+}
+
+bool Xsea::Query::fail(const std::string &message) {
+    _error += message;
+    _steps.clear();
+    return false;
+}
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cstring>
+#include "../include/xsea.h"
+
+namespace {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v';
+}
+
+bool isBlank(Xsea::StringRef value) {
+    for (char c : value) {
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\v')
+            return false;
+    }
+    return true;
+}
+
+// no whitespace at either end and no run of it inside but single spaces
+bool isNormal(Xsea::StringRef value) {
+    if (value.empty())
+        return true;
+    if (isSpace(value[0]) || isSpace(value.back()))
+        return false;
+    for (std::size_t i = 1; i < value.size(); i++) {
+        char c = value[i];
+        if (isSpace(c) && (c != ' ' || isSpace(value[i - 1])))
+            return false;
+    }
+    return true;
+}
+
+// trim and collapse in place, the new size
+std::size_t normalize(char *data, std::size_t size) {
+    std::size_t to = 0;
+    bool space = false;
+    for (std::size_t i = 0; i < size; i++) {
+        if (isSpace(data[i])) {
+            space = to != 0;
+            continue;
+        }
+        if (space)
+            data[to++] = ' ';
+        space = false;
+        data[to++] = data[i];
+    }
+    return to;
+}
+
+}
+
+const std::size_t Xsea::Reader::pushStep;
+
+bool Xsea::Reader::open(std::istream &is) {
+    begin();
+    if (!is)
+        return fail("Bad stream\n");
+    _is = &is;
+    _window.resize(blockSize);
+    _last = false;
+    return refill();
+}
+
+bool Xsea::Reader::open(const char *data, std::size_t size) {
+    begin();
+    _tokenizer.setInput(data, data + size, true);
+    return true;
+}
+
+bool Xsea::Reader::openPush() {
+    begin();
+    _pushing = true;
+    _last = false;
+    _tokenizer.setInput(_window.data(), _window.data(), false);
+    return true;
+}
+
+bool Xsea::Reader::feed(const char *data, std::size_t size, bool last) {
+    if (!_pushing || _last)
+        return fail("Nothing more can be fed\n");
+    _chunk = data;
+    _chunkEnd = data + size;
+    _last = last;
+    _waiting = false;
+    return good();
+}
+
+bool Xsea::Reader::openFile(const std::string &fileName) {
+    begin();
+    _file = std::make_shared<MappedFile>(fileName);
+    if (!_file->isOpen())
+        return fail("Cannot open " + fileName + '\n');
+    _file->adviseSequential(true);
+    _tokenizer.setInput(_file->data(), _file->data() + _file->size(), true);
+    return true;
+}
+
+void Xsea::Reader::replay(const Token *begin, const Token *end, bool last) {
+    _replaying = true;
+    _replay = begin;
+    _replayEnd = end;
+    _last = last;
+}
+
+bool Xsea::Reader::next() {
+    if (_done)
+        return false;
+    while (true) {
+        Tokenizer::Status status;
+        if (_replaying) {
+            if (_replay != _replayEnd) {
+                _token = *_replay++;
+                status = Tokenizer::Status::_token;
+            } else {
+                status = _last ? Tokenizer::Status::_end : Tokenizer::Status::_incomplete;
+            }
+        } else {
+            status = _tokenizer.next(_token);
+        }
+        switch (status) {
+            case Tokenizer::Status::_token:
+                if (accept())
+                    return true;
+                if (_done)
+                    return false;
+                break; // a blank text, go on
+            case Tokenizer::Status::_incomplete:
+                if (_pushing ? !pull() : !refill())
+                    return false;
+                break;
+            case Tokenizer::Status::_end:
+                return finish();
+            case Tokenizer::Status::_error:
+                return fail(_tokenizer.getError());
+        }
+    }
+}
+
+bool Xsea::Reader::skipSubtree() {
+    if (_token.type != NodeType::_element || _token.selfClosing)
+        return good();
+    std::size_t target = _depth;
+    _skipping = true;
+    while (next()) {
+        if (_token.type == NodeType::_back && _depth == target) {
+            _skipping = false;
+            return true;
+        }
+    }
+    _skipping = false;
+    return false;
+}
+
+Xsea::NodeType Xsea::Reader::nodeType() const {
+    return _token.type;
+}
+
+Xsea::StringRef Xsea::Reader::name() const {
+    return _token.name;
+}
+
+Xsea::StringRef Xsea::Reader::value() const {
+    if (_token.type != NodeType::_text || (!_token.references && _whitespace != Whitespace::_normalize))
+        return _token.value;
+    if (_textDecoded)
+        return _textValue;
+    _textDecoded = true;
+    _textValue = _token.value;
+    if (_token.references) {
+        decodeEntities(_token.value, _text);
+        _textValue = StringRef(_text);
+    }
+    if (_whitespace == Whitespace::_normalize && !isNormal(_textValue)) { // a copy only when it changes
+        if (_textValue.data() != _text.data())
+            _text = _textValue.str();
+        _text.resize(normalize(&_text[0], _text.size()));
+        _textValue = StringRef(_text);
+    }
+    return _textValue;
+}
+
+Xsea::StringRef Xsea::Reader::rawValue() const {
+    return _token.value;
+}
+
+bool Xsea::Reader::hasReferences() const {
+    return _token.references;
+}
+
+const std::vector<Xsea::Attribute> &Xsea::Reader::attributes() const {
+    return _attributes;
+}
+
+bool Xsea::Reader::isEmptyElement() const {
+    return _token.type == NodeType::_element && _token.selfClosing;
+}
+
+std::size_t Xsea::Reader::depth() const {
+    return _depth;
+}
+
+void Xsea::Reader::setWhitespace(Whitespace policy) {
+    _whitespace = policy;
+}
+
+Xsea::Whitespace Xsea::Reader::whitespace() const {
+    return _whitespace;
+}
+
+bool Xsea::Reader::waiting() const {
+    return _waiting;
+}
+
+bool Xsea::Reader::good() const {
+    return _error.empty();
+}
+
+std::string Xsea::Reader::getError() const {
+    return _error;
+}
+
+const char *Xsea::Reader::getErrorC() const {
+    return _error.c_str();
+}
+
+void Xsea::Reader::begin() {
+    _token = Token();
+    _depth = 0;
+    _error.clear();
+    _replaying = false;
+    _replay = nullptr;
+    _replayEnd = nullptr;
+    _is = nullptr;
+    _filled = 0;
+    _last = true;
+    _pushing = false;
+    _waiting = false;
+    _inWindow = true;
+    _chunk = nullptr;
+    _chunkEnd = nullptr;
+    _appended = 0;
+    _file.reset();
+    _tokenizer.setInput(nullptr, nullptr, true); // nothing of the previous input is kept
+    _names.clear();
+    _nameStarts.clear();
+    _started = false;
+    _rootDone = false;
+    _done = false;
+    _skipping = false;
+}
+
+bool Xsea::Reader::refill() {
+    if (_is == nullptr || _last)
+        return false;
+    // keep the unfinished token, grow when a single token fills the window
+    const char *pos = _tokenizer.position();
+    auto rest = pos == nullptr ? 0 : static_cast<std::size_t>(_window.data() + _filled - pos);
+    if (rest != 0)
+        std::memmove(_window.data(), pos, rest);
+    _filled = rest;
+    if (_filled == _window.size())
+        _window.resize(_window.size() * 2);
+    _is->read(_window.data() + _filled, static_cast<std::streamsize>(_window.size() - _filled));
+    _filled += static_cast<std::size_t>(_is->gcount());
+    _last = !*_is;
+    _tokenizer.resume(_window.data(), _window.data() + _filled, _last);
+    return true;
+}
+
+bool Xsea::Reader::pull() {
+    const char *pos = _tokenizer.position();
+    auto rest = static_cast<std::size_t>((_inWindow ? _window.data() + _filled : _chunk) - pos);
+    if (_inWindow && rest <= _appended && _chunk != _chunkEnd) { // the unfinished token began in the chunk, go on there
+        _tokenizer.resume(_chunk - rest, _chunkEnd, _last);
+        _chunk = _chunkEnd;
+        _inWindow = false;
+        _filled = 0;
+        _appended = 0;
+        return true;
+    }
+    // the unfinished token stays in the window, the caller may drop the chunk once we wait
+    std::size_t step = std::min(static_cast<std::size_t>(_chunkEnd - _chunk), std::max(rest, pushStep));
+    if (_inWindow && rest != 0)
+        std::memmove(_window.data(), pos, rest);
+    if (_window.size() < rest + step)
+        _window.resize(std::max(_window.size() * 2, rest + step));
+    if (!_inWindow && rest != 0)
+        std::memcpy(_window.data(), pos, rest);
+    if (step != 0) // a step at a time, most tokens end early in it
+        std::memcpy(_window.data() + rest, _chunk, step);
+    _chunk += step;
+    _filled = rest + step;
+    _appended = step;
+    _inWindow = true;
+    bool last = _last && _chunk == _chunkEnd;
+    _tokenizer.resume(_window.data(), _window.data() + _filled, last);
+    _waiting = step == 0 && !last;
+    return !_waiting;
+}
+
+bool Xsea::Reader::accept() {
+    _textDecoded = false;
+    switch (_token.type) {
+        case NodeType::_declaration: {
+            if (_started) { // a late <?xml ...?> is only a processing instruction
+                _token.type = NodeType::_instruction;
+                _token.value = _token.value.substr(1, _token.value.size() - 2);
+            }
+            _depth = _nameStarts.size();
+            break;
+        }
+        case NodeType::_cdata: {
+            if (_nameStarts.empty())
+                return fail("CDATA outside the root element\n");
+            _depth = _nameStarts.size();
+            break;
+        }
+        case NodeType::_doctype: {
+            if (!_nameStarts.empty() || _rootDone)
+                return fail("DOCTYPE after the root element started\n");
+            _depth = 0;
+            break;
+        }
+        case NodeType::_element: {
+            if (_rootDone) { // the remains can only be comments
+                _done = true;
+                return false;
+            }
+            _depth = _nameStarts.size();
+            if (_skipping) // nobody looks at them
+                _attributes.clear();
+            else if (!parseAttributes())
+                return false;
+            if (!_token.selfClosing) {
+                _nameStarts.push_back(_names.size());
+                _names.append(_token.name.data(), _token.name.size());
+            } else {
+                _rootDone = _nameStarts.empty();
+            }
+            break;
+        }
+        case NodeType::_back: {
+            if (_nameStarts.empty() ||
+                StringRef(_names.data() + _nameStarts.back(), _names.size() - _nameStarts.back()) != _token.name)
+                return fail("Back tag doesn't match previous tag at </" + _token.name.str() + ">\n");
+            _names.resize(_nameStarts.back());
+            _nameStarts.pop_back();
+            _depth = _nameStarts.size();
+            _rootDone = _nameStarts.empty();
+            break;
+        }
+        case NodeType::_text: {
+            if (isBlank(_token.value) && (_whitespace != Whitespace::_preserve || _nameStarts.empty()))
+                return false; // skipped before anyone makes a node of it
+            if (_nameStarts.empty()) {
+                if (!_rootDone)
+                    return fail("Text outside the root element at " + _token.value.str() + '\n');
+                _done = true;
+                return false;
+            }
+            _depth = _nameStarts.size();
+            break;
+        }
+        default:
+            _depth = _nameStarts.size();
+            break;
+    }
+    _started = true;
+    return true;
+}
+
+bool Xsea::Reader::parseAttributes() {
+    _attributes.clear();
+    const char *p = _token.rawAttributes.begin();
+    const char *end = _token.rawAttributes.end();
+    while (true) {
+        while (p < end && isSpace(*p))
+            p++;
+        if (p == end)
+            return true;
+        const char *key = p;
+        while (p < end && *p != '=' && !isSpace(*p))
+            p++;
+        StringRef keyRef(key, static_cast<std::size_t>(p - key));
+        while (p < end && isSpace(*p))
+            p++;
+        if (p == end || *p != '=' || keyRef.empty())
+            return fail("Attribute without value in <" + _token.value.str() + ">\n");
+        p++;
+        while (p < end && isSpace(*p))
+            p++;
+        if (p == end || (*p != '"' && *p != '\''))
+            return fail("Unquoted attribute value in <" + _token.value.str() + ">\n");
+        char quote = *p++;
+        auto close = static_cast<const char *>(std::memchr(p, quote, static_cast<std::size_t>(end - p)));
+        if (close == nullptr)
+            return fail("Unclosed attribute value in <" + _token.value.str() + ">\n");
+        StringRef value(p, static_cast<std::size_t>(close - p));
+        std::size_t slot = _attributes.size();
+        if (slot == _decoded.size())
+            _decoded.emplace_back();
+        if (decodeEntities(value, _decoded[slot]))
+            value = StringRef(_decoded[slot]);
+        _attributes.push_back(Attribute::refer(keyRef, value));
+        p = close + 1;
+    }
+}
+
+bool Xsea::Reader::finish() {
+    _done = true;
+    _token = Token();
+    if (!_nameStarts.empty())
+        return fail("Unclosed tag <" + _names.substr(_nameStarts.back()) + ">\n");
+    if (!_rootDone)
+        return fail("No root\n");
+    return false;
+}
+
+bool Xsea::Reader::fail(const std::string &message) {
+    _error += message;
+    _done = true;
+    return false;
+}
@@ -0,0 +1,182 @@
+#include <cstring>
+#include "../include/xsea.h"
+
+bool Xsea::SaxHandler::declaration(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::startElement(StringRef, const std::vector<Attribute> &) {
+    return true;
+}
+
+bool Xsea::SaxHandler::endElement(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::text(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::encodedText(StringRef value) {
+    std::string decoded;
+    decodeEntities(value, decoded);
+    return text(StringRef(decoded));
+}
+
+bool Xsea::SaxHandler::comment(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::unknown(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::cdata(StringRef value) {
+    return text(value);
+}
+
+bool Xsea::SaxHandler::processingInstruction(StringRef) {
+    return true;
+}
+
+bool Xsea::SaxHandler::doctype(StringRef) {
+    return true;
+}
+
+Xsea::SaxParser::SaxParser(Xsea::SaxHandler &handler) : _handler(handler) {}
+
+bool Xsea::SaxParser::parse(std::istream &is) {
+    Reader reader;
+    reader.setWhitespace(_whitespace);
+    reader.open(is);
+    return parse(reader);
+}
+
+bool Xsea::SaxParser::parse(const char *data, std::size_t size) {
+    Reader reader;
+    reader.setWhitespace(_whitespace);
+    reader.open(data, size);
+    return parse(reader);
+}
+
+bool Xsea::SaxParser::parseFile(const std::string &fileName) {
+    Reader reader;
+    reader.setWhitespace(_whitespace);
+    reader.openFile(fileName);
+    return parse(reader);
+}
+
+void Xsea::SaxParser::setWhitespace(Whitespace policy) {
+    _whitespace = policy;
+}
+
+bool Xsea::SaxParser::stopped() const {
+    return _stopped;
+}
+
+std::string Xsea::SaxParser::getError() const {
+    return _error;
+}
+
+const char *Xsea::SaxParser::getErrorC() const {
+    return _error.c_str();
+}
+
+bool Xsea::SaxParser::parse(Xsea::Reader &reader) {
+    _error.clear();
+    bool go = true;
+    while (go && reader.next()) {
+        switch (reader.nodeType()) {
+            case NodeType::_declaration:
+                go = _handler.declaration(reader.value());
+                break;
+            case NodeType::_element:
+                go = _handler.startElement(reader.name(), reader.attributes());
+                if (go && reader.isEmptyElement())
+                    go = _handler.endElement(reader.name());
+                break;
+            case NodeType::_back:
+                go = _handler.endElement(reader.name());
+                break;
+            case NodeType::_text:
+                if (reader.hasReferences() && reader.whitespace() != Whitespace::_normalize)
+                    go = _handler.encodedText(reader.rawValue());
+                else
+                    go = _handler.text(reader.value());
+                break;
+            case NodeType::_comment:
+                go = _handler.comment(reader.value());
+                break;
+            case NodeType::_unknown:
+                go = _handler.unknown(reader.value());
+                break;
+            case NodeType::_cdata:
+                go = _handler.cdata(reader.value());
+                break;
+            case NodeType::_instruction:
+                go = _handler.processingInstruction(reader.value());
+                break;
+            case NodeType::_doctype:
+                go = _handler.doctype(reader.value());
+                break;
+            default:
+                break;
+        }
+    }
+    _stopped = !go;
+    _error += reader.getError();
+    return reader.good();
+}
+
+Xsea::PushParser::PushParser(Xsea::SaxHandler &handler) : _parser(handler) {
+    _reader.openPush();
+}
+
+bool Xsea::PushParser::feed(const char *data, std::size_t size) {
+    if (_done)
+        return false;
+    _reader.feed(data, size, false);
+    return run();
+}
+
+bool Xsea::PushParser::finish() {
+    if (_done)
+        return good();
+    _reader.feed(nullptr, 0, true);
+    run();
+    _done = true;
+    return good();
+}
+
+void Xsea::PushParser::restart() {
+    _reader.openPush();
+    _error.clear();
+    _done = false;
+}
+
+void Xsea::PushParser::setWhitespace(Whitespace policy) {
+    _reader.setWhitespace(policy);
+}
+
+bool Xsea::PushParser::good() const {
+    return _error.empty();
+}
+
+std::string Xsea::PushParser::getError() const {
+    return _error;
+}
+
+const char *Xsea::PushParser::getErrorC() const {
+    return _error.c_str();
+}
+
+bool Xsea::PushParser::run() {
+    if (!_parser.parse(_reader)) {
+        _error += _parser.getError();
+        _done = true;
+        return false;
+    }
+    if (!_reader.waiting()) // the handler stopped, or the document ended before the data did
+        _done = true;
+    return !_parser.stopped();
+}
@@ -0,0 +1,169 @@
+#include "../include/xsea.h"
+
+class Xsea::Document::Serializer {
+public:
+    Serializer(OutputBuffer &out, const SaveOptions &options) :
+            _out(out), _pretty(options.pretty), _indent(options.indent) {}
+
+    void document(const Document &doc) {
+        if (doc._declarationPtr != nullptr) {
+            put('<');
+            put(doc._declarationPtr->getValueRef());
+            put('>');
+            newline();
+        }
+        for (const Node *node = doc._root->_first; node != nullptr; node = node->_next) {
+            if (node->_type == NodeType::_element) {
+                element(static_cast<const Element &>(*node), 0);
+            } else if (node->_type != NodeType::_text) {
+                nonelement(*node);
+                newline();
+            }
+        }
+    }
+
+    // same layout as always: leaves on one line, a single short comment inline with its tags
+    // text is content, so an element holding any is written with no layout whitespace at all
+    void element(const Element &elem, unsigned depth) {
+        indent(depth);
+        put('<');
+        put(elem.getValueRef());
+        attributes(elem._attributes);
+        if (elem._size == 0) {
+            put("/>", 2);
+            newline();
+            return;
+        }
+        put('>');
+        if (_pretty && hasText(elem)) {
+            _pretty = false;
+            for (const Node *node = elem._first; node != nullptr; node = node->_next) {
+                if (node->_type == NodeType::_element)
+                    element(static_cast<const Element &>(*node), 0);
+                else
+                    nonelement(*node);
+            }
+            _pretty = true;
+        } else if (elem._size == 1 && elem._first->_type != NodeType::_element) {
+            const Node &only = *elem._first;
+            if (!_pretty || only.getValueRef().size() < 40) {
+                nonelement(only);
+            } else {
+                newline();
+                indent(depth + 1);
+                nonelement(only);
+                newline();
+                indent(depth);
+            }
+        } else {
+            newline();
+            for (const Node *node = elem._first; node != nullptr; node = node->_next) {
+                if (node->_type == NodeType::_element) {
+                    element(static_cast<const Element &>(*node), depth + 1);
+                } else {
+                    indent(depth + 1);
+                    nonelement(*node);
+                    newline();
+                }
+            }
+            indent(depth);
+        }
+        put("</", 2);
+        put(elem.getValueRef());
+        put('>');
+        newline();
+    }
+
+private:
+    OutputBuffer &_out;
+    bool _pretty;
+    unsigned _indent;
+    std::string _spaces; // the deepest indent so far, shallower ones are prefixes
+
+    void put(char c) {
+        _out.put(c);
+    }
+
+    void put(const char *data, std::size_t size) {
+        _out.put(data, size);
+    }
+
+    void put(StringRef str) {
+        _out.put(str);
+    }
+
+    static bool hasText(const Element &elem) {
+        for (const Node *node = elem._first; node != nullptr; node = node->_next) {
+            if (node->_type == NodeType::_text || node->_type == NodeType::_cdata)
+                return true;
+        }
+        return false;
+    }
+
+    void newline() {
+        if (_pretty)
+            put('\n');
+    }
+
+    void indent(unsigned depth) {
+        if (!_pretty)
+            return;
+        std::size_t n = static_cast<std::size_t>(depth) * _indent;
+        if (_spaces.size() < n)
+            _spaces.resize(n * 2, ' ');
+        put(_spaces.data(), n);
+    }
+
+    void nonelement(const Node &node) {
+        switch (node._type) {
+            case NodeType::_text:
+                _out.putEscaped(node.getValueRef(), false);
+                return;
+            case NodeType::_comment:
+                put("<!--", 4);
+                put(node.getValueRef());
+                put("-->", 3);
+                return;
+            case NodeType::_unknown:
+                put('<');
+                put(node.getValueRef());
+                put('>');
+                return;
+            case NodeType::_cdata:
+                _out.putCData(node.getValueRef());
+                return;
+            case NodeType::_instruction:
+                put("<?", 2);
+                put(node.getValueRef());
+                put("?>", 2);
+                return;
+            case NodeType::_doctype:
+                put("<!DOCTYPE ", 10);
+                put(node.getValueRef());
+                put('>');
+                return;
+            default:
+                return;
+        }
+    }
+
+    void attributes(const std::vector<Attribute> &attributes) {
+        for (const Attribute &attr : attributes) {
+            put(' ');
+            put(attr.getKeyRef());
+            put("=\"", 2);
+            _out.putEscaped(attr.getValueRef(), true);
+            put('"');
+        }
+    }
+};
+
+void Xsea::Document::save(std::ostream &os, const SaveOptions &options) const {
+    OutputBuffer out(os);
+    Serializer(out, options).document(*this);
+}
+
+void Xsea::Document::saveBuffer(std::string &out, const SaveOptions &options) const {
+    OutputBuffer buffer(out);
+    Serializer(buffer, options).document(*this);
+}
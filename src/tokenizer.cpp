@@ -0,0 +1,334 @@
+#include <cstring>
+#include "../include/xsea.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline unsigned countTrailingZeros(std::uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long ret;
+    _BitScanForward64(&ret, mask);
+    return static_cast<unsigned>(ret);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// '<' and '>' differ in one bit, so do '&' and '\'', three compares cover < > & ' "
+#if defined(__AVX2__)
+
+inline std::uint32_t structural32(const char *p) {
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i m = _mm256_or_si256(
+            _mm256_cmpeq_epi8(_mm256_or_si256(v, _mm256_set1_epi8(2)), _mm256_set1_epi8('>')),
+            _mm256_cmpeq_epi8(_mm256_or_si256(v, _mm256_set1_epi8(1)), _mm256_set1_epi8('\'')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+}
+
+inline std::uint64_t structural64(const char *p) {
+    return structural32(p) | static_cast<std::uint64_t>(structural32(p + 32)) << 32;
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+inline std::uint32_t structural16(const char *p) {
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i m = _mm_or_si128(
+            _mm_cmpeq_epi8(_mm_or_si128(v, _mm_set1_epi8(2)), _mm_set1_epi8('>')),
+            _mm_cmpeq_epi8(_mm_or_si128(v, _mm_set1_epi8(1)), _mm_set1_epi8('\'')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(m));
+}
+
+inline std::uint64_t structural64(const char *p) {
+    return structural16(p) | static_cast<std::uint64_t>(structural16(p + 16)) << 16 |
+           static_cast<std::uint64_t>(structural16(p + 32)) << 32 |
+           static_cast<std::uint64_t>(structural16(p + 48)) << 48;
+}
+
+#else
+
+inline std::uint64_t structural64(const char *p) {
+    std::uint64_t mask = 0;
+    for (unsigned i = 0; i < 64; i++) {
+        char c = p[i];
+        if ((c | 2) == '>' || (c | 1) == '\'' || c == '"')
+            mask |= std::uint64_t(1) << i;
+    }
+    return mask;
+}
+
+#endif
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v';
+}
+
+inline bool isNameStart(char c) {
+    return isalpha(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+}
+
+}
+
+std::uint64_t Xsea::Tokenizer::structuralMask(const char *block, const char *begin, const char *end) {
+    if (block >= begin && end - block >= 64)
+        return structural64(block);
+    alignas(64) char edge[64] = {}; // zero padding never matches
+    const char *from = block < begin ? begin : block;
+    const char *to = end - block < 64 ? end : block + 64;
+    std::memcpy(edge + (from - block), from, static_cast<std::size_t>(to - from));
+    return structural64(edge);
+}
+
+inline const char *Xsea::Tokenizer::nextStructural(const char *from) {
+    while (from < _end) {
+        if (from < _block || from >= _block + 64 || _block == nullptr) {
+            _block = reinterpret_cast<const char *>(reinterpret_cast<std::uintptr_t>(from) & ~std::uintptr_t(63));
+            _mask = structuralMask(_block, _begin, _end);
+        }
+        std::uint64_t mask = _mask & (~std::uint64_t(0) << (from - _block));
+        if (mask != 0)
+            return _block + countTrailingZeros(mask);
+        from = _block + 64;
+    }
+    return _end;
+}
+
+void Xsea::Tokenizer::setInput(const char *begin, const char *end, bool last) {
+    _begin = begin;
+    _pos = begin;
+    _end = end;
+    _last = last;
+    _block = nullptr;
+    _scanned = 0;
+    _quote = 0;
+    _references = false;
+}
+
+void Xsea::Tokenizer::resume(const char *begin, const char *end, bool last) {
+    _begin = begin;
+    _pos = begin;
+    _end = end;
+    _last = last;
+    _block = nullptr;
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::next(Xsea::Token &token) {
+    if (_pos == _end)
+        return _last ? Status::_end : Status::_incomplete;
+    token = Token();
+    if (*_pos != '<') { // text runs up to the next tag
+        const char *lt = nextStructural(_pos + _scanned);
+        bool references = _references;
+        while (lt != _end && *lt != '<') {
+            references = references || *lt == '&';
+            lt = nextStructural(lt + 1);
+        }
+        if (lt == _end && !_last) {
+            _references = references;
+            return incomplete(_end, 0);
+        }
+        token.type = NodeType::_text;
+        token.value = StringRef(_pos, static_cast<std::size_t>(lt - _pos));
+        token.references = references;
+        _pos = lt;
+        _scanned = 0;
+        _references = false;
+        return Status::_token;
+    }
+    Status status = markup(token);
+    if (status == Status::_token) {
+        _scanned = 0;
+        _quote = 0;
+    }
+    return status;
+}
+
+const char *Xsea::Tokenizer::position() const {
+    return _pos;
+}
+
+std::string Xsea::Tokenizer::getError() const {
+    return _error;
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::markup(Xsea::Token &token) {
+    const char *p = _pos + 1;
+    const char *close = nullptr;
+    if (p == _end)
+        return _last ? fail("Unexpected end after <\n") : Status::_incomplete;
+
+    switch (*p) {
+        case '/': { // </tag>
+            Status status = until(">", 1, p, close);
+            if (status != Status::_token)
+                return status;
+            const char *e = close;
+            while (e > p + 1 && isSpace(e[-1]))
+                e--;
+            token.type = NodeType::_back;
+            token.name = StringRef(p + 1, static_cast<std::size_t>(e - p - 1));
+            token.value = StringRef(p, static_cast<std::size_t>(close - p));
+            _pos = close + 1;
+            return Status::_token;
+        }
+        case '?': { // <?xml ...?> or another processing instruction
+            Status status = until("?>", 2, p + 1, close);
+            if (status != Status::_token)
+                return status;
+            token.value = StringRef(p, static_cast<std::size_t>(close + 1 - p));
+            bool decl = token.value.size() > 5 && token.value.substr(0, 4) == StringRef("?xml") &&
+                        (isSpace(token.value[4]) || token.value[4] == '?');
+            if (decl) {
+                token.type = NodeType::_declaration;
+            } else { // the value is target and data
+                token.type = NodeType::_instruction;
+                token.value = token.value.substr(1, token.value.size() - 2);
+            }
+            _pos = close + 2;
+            return Status::_token;
+        }
+        case '!': {
+            if (static_cast<std::size_t>(_end - _pos) < 10 && !_last) // the longest prefix is <!DOCTYPE and a space
+                return Status::_incomplete;
+            StringRef head = StringRef(_pos, static_cast<std::size_t>(_end - _pos)).substr(0, 9);
+            if (head.substr(0, 4) == StringRef("<!--")) {
+                Status status = until("-->", 3, _pos + 4, close);
+                if (status != Status::_token)
+                    return status;
+                token.type = NodeType::_comment;
+                token.value = StringRef(_pos + 4, static_cast<std::size_t>(close - _pos - 4));
+                _pos = close + 3;
+                return Status::_token;
+            }
+            if (head == StringRef("<![CDATA[")) { // the body is taken as it is, '<' and '>' included
+                Status status = until("]]>", 3, _pos + 9, close);
+                if (status != Status::_token)
+                    return status;
+                token.type = NodeType::_cdata;
+                token.value = StringRef(_pos + 9, static_cast<std::size_t>(close - _pos - 9));
+                _pos = close + 3;
+                return Status::_token;
+            }
+            if (head == StringRef("<!DOCTYPE") && _end - _pos > 9 && isSpace(_pos[9]))
+                return doctype(token);
+            Status status = until(">", 1, p, close);
+            if (status != Status::_token)
+                return status;
+            token.type = NodeType::_unknown;
+            token.value = StringRef(p, static_cast<std::size_t>(close - p));
+            _pos = close + 1;
+            return Status::_token;
+        }
+        default:
+            break;
+    }
+
+    if (!isNameStart(*p)) {
+        Status status = until(">", 1, p, close);
+        if (status != Status::_token)
+            return status;
+        token.type = NodeType::_unknown;
+        token.value = StringRef(p, static_cast<std::size_t>(close - p));
+        _pos = close + 1;
+        return Status::_token;
+    }
+
+    // start tag, a quoted attribute value may contain '>'
+    char quote = _quote;
+    for (close = nextStructural(_scanned != 0 ? _pos + _scanned : p); close != _end; close = nextStructural(close + 1)) {
+        char c = *close;
+        if (quote != 0) {
+            if (c == quote)
+                quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            break;
+        }
+    }
+    if (close == _end)
+        return _last ? fail("Unexpected end in tag " + StringRef(_pos, static_cast<std::size_t>(_end - _pos)).str() + '\n')
+                     : incomplete(_end, quote);
+
+    const char *n = p;
+    while (n < close && !isSpace(*n) && *n != '/')
+        n++;
+    const char *e = close;
+    token.selfClosing = e > n && e[-1] == '/';
+    if (token.selfClosing)
+        e--;
+    token.type = NodeType::_element;
+    token.name = StringRef(p, static_cast<std::size_t>(n - p));
+    token.rawAttributes = StringRef(n, static_cast<std::size_t>(e - n));
+    token.value = StringRef(p, static_cast<std::size_t>(close - p));
+    _pos = close + 1;
+    return Status::_token;
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::doctype(Xsea::Token &token) {
+    // an internal subset in [ ] holds declarations of its own, quoted literals may hold anything
+    char quote = 0;
+    std::size_t nesting = 0;
+    const char *p = _pos + 9;
+    for (; p != _end; p++) {
+        char c = *p;
+        if (quote != 0) {
+            if (c == quote)
+                quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '[') {
+            nesting++;
+        } else if (c == ']' && nesting != 0) {
+            nesting--;
+        } else if (c == '>' && nesting == 0) {
+            break;
+        }
+    }
+    if (p == _end) // short enough to scan again when more comes
+        return _last ? fail("Unexpected end in <!DOCTYPE\n") : Status::_incomplete;
+    const char *begin = _pos + 9;
+    while (begin < p && isSpace(*begin))
+        begin++;
+    token.type = NodeType::_doctype;
+    token.value = StringRef(begin, static_cast<std::size_t>(p - begin));
+    _pos = p + 1;
+    return Status::_token;
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::until(const char *terminator, std::size_t length,
+                                               const char *from, const char *&found) {
+    if (_pos + _scanned > from) // the terminator was not in what an earlier call saw
+        from = _pos + _scanned;
+    while (static_cast<std::size_t>(_end - from) >= length) {
+        auto hit = static_cast<const char *>(std::memchr(from, terminator[0],
+                                                         static_cast<std::size_t>(_end - from)));
+        if (hit == nullptr || static_cast<std::size_t>(_end - hit) < length)
+            break;
+        if (std::memcmp(hit, terminator, length) == 0) {
+            found = hit;
+            return Status::_token;
+        }
+        from = hit + 1;
+    }
+    if (!_last) // a terminator split by the end may start in its last length - 1 characters
+        return incomplete(static_cast<std::size_t>(_end - from) < length ? from : _end - (length - 1), 0);
+    return fail("Missing " + std::string(terminator) + " after " +
+                StringRef(_pos, static_cast<std::size_t>(_end - _pos < 32 ? _end - _pos : 32)).str() + '\n');
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::incomplete(const char *scanned, char quote) {
+    _scanned = static_cast<std::size_t>(scanned - _pos);
+    _quote = quote;
+    return Status::_incomplete;
+}
+
+Xsea::Tokenizer::Status Xsea::Tokenizer::fail(const std::string &message) {
+    _error = message;
+    return Status::_error;
+}
@@ -0,0 +1,445 @@
+#include "../include/xsea.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *escapeOf(char c, bool attribute) {
+    switch (c) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return attribute ? nullptr : "&gt;";
+        case '"': return attribute ? "&quot;" : nullptr;
+        default: return nullptr;
+    }
+}
+
+inline unsigned countTrailingZeros(std::uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long ret;
+    _BitScanForward64(&ret, mask);
+    return static_cast<unsigned>(ret);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// the next character needing an escape, < > & ' " are found 64 at a time by the tokenizer's structural mask
+const char *nextEscape(const char *p, const char *begin, const char *end, bool attribute) {
+    if (end - p < 16) { // too short to pay for a block
+        while (p != end && escapeOf(*p, attribute) == nullptr)
+            p++;
+        return p;
+    }
+    while (p < end) {
+        auto block = reinterpret_cast<const char *>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(63));
+        std::uint64_t mask = Xsea::Tokenizer::structuralMask(block, begin, end) & (~std::uint64_t(0) << (p - block));
+        for (; mask != 0; mask &= mask - 1) {
+            const char *hit = block + countTrailingZeros(mask);
+            if (hit >= end)
+                return end;
+            if (escapeOf(*hit, attribute) != nullptr)
+                return hit;
+        }
+        p = block + 64;
+    }
+    return end;
+}
+
+bool isName(Xsea::StringRef name) {
+    if (name.empty())
+        return false;
+    for (char c : name) {
+        switch (c) {
+            case ' ': case '\t': case '\r': case '\n':
+            case '<': case '>': case '&': case '"': case '\'': case '/': case '=':
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+}
+
+Xsea::OutputBuffer::OutputBuffer(int fd) : _target(&_buffer), _fd(fd) {
+    _buffer.reserve(flushSize + 4096);
+}
+
+Xsea::OutputBuffer::OutputBuffer(std::ostream &os) : _target(&_buffer), _os(&os) {
+    _buffer.reserve(flushSize + 4096);
+}
+
+Xsea::OutputBuffer::OutputBuffer(std::string &out) : _target(&out) {}
+
+Xsea::OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+void Xsea::OutputBuffer::putEscaped(StringRef str, bool attribute) {
+    const char *run = str.begin();
+    for (const char *p = nextEscape(run, str.begin(), str.end(), attribute); p != str.end();
+         p = nextEscape(p + 1, str.begin(), str.end(), attribute)) { // copy the runs between escapes in one go
+        const char *escape = escapeOf(*p, attribute);
+        put(run, static_cast<std::size_t>(p - run));
+        put(escape, std::strlen(escape));
+        run = p + 1;
+    }
+    put(run, static_cast<std::size_t>(str.end() - run));
+}
+
+void Xsea::OutputBuffer::putCData(StringRef str) {
+    put("<![CDATA[", 9);
+    const char *run = str.begin();
+    for (const char *p = run; str.end() - p >= 3; p++) {
+        if (p[0] == ']' && p[1] == ']' && p[2] == '>') { // the > goes to a section of its own
+            put(run, static_cast<std::size_t>(p + 2 - run));
+            put("]]><![CDATA[", 12);
+            run = p + 2;
+        }
+    }
+    put(run, static_cast<std::size_t>(str.end() - run));
+    put("]]>", 3);
+}
+
+std::size_t Xsea::OutputBuffer::escapedSize(StringRef str, bool attribute) {
+    std::size_t size = str.size();
+    for (const char *p = nextEscape(str.begin(), str.begin(), str.end(), attribute); p != str.end();
+         p = nextEscape(p + 1, str.begin(), str.end(), attribute))
+        size += std::strlen(escapeOf(*p, attribute)) - 1;
+    return size;
+}
+
+bool Xsea::OutputBuffer::flush() {
+    if (_target != &_buffer || _buffer.empty())
+        return _good;
+    if (_os != nullptr) {
+        _good = _good && _os->write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+    } else {
+        const char *p = _buffer.data();
+        std::size_t left = _buffer.size();
+        while (_good && left > 0) {
+#ifdef _WIN32
+            auto n = ::_write(_fd, p, static_cast<unsigned>(left));
+#else
+            auto n = ::write(_fd, p, left);
+#endif
+            if (n <= 0)
+                _good = false;
+            else {
+                p += n;
+                left -= static_cast<std::size_t>(n);
+            }
+        }
+    }
+    _buffer.clear(); // keeps the capacity
+    return _good;
+}
+
+bool Xsea::OutputBuffer::good() const {
+    return _good;
+}
+
+Xsea::XmlWriter::XmlWriter(int fd, const SaveOptions &options) :
+        _out(fd), _pretty(options.pretty), _indent(options.indent) {}
+
+Xsea::XmlWriter::XmlWriter(std::ostream &os, const SaveOptions &options) :
+        _out(os), _pretty(options.pretty), _indent(options.indent) {}
+
+Xsea::XmlWriter::XmlWriter(std::string &out, const SaveOptions &options) :
+        _out(out), _pretty(options.pretty), _indent(options.indent) {}
+
+bool Xsea::XmlWriter::declaration(StringRef value) {
+    if (!_error.empty())
+        return false;
+    if (_started)
+        return fail("Declaration after content\n");
+    _out.put('<');
+    _out.put(value);
+    _out.put('>');
+    newline();
+    _started = true;
+    return true;
+}
+
+bool Xsea::XmlWriter::startElement(StringRef name) {
+    if (!_error.empty())
+        return false;
+    if (!isName(name))
+        return fail("Invalid element name " + name.str() + "\n");
+    if (_nameStarts.empty() && _rootDone)
+        return fail("Second root element <" + name.str() + ">\n");
+    if (!child(true))
+        return false;
+    indent(_nameStarts.size());
+    _out.put('<');
+    _out.put(name);
+    _nameStarts.push_back(_names.size());
+    _names.append(name.data(), name.size());
+    _tagOpen = true;
+    _broken = false;
+    _started = true;
+    return true;
+}
+
+bool Xsea::XmlWriter::attribute(StringRef key, StringRef value) {
+    if (!_error.empty())
+        return false;
+    if (!_tagOpen)
+        return fail("Attribute " + key.str() + " outside a start tag\n");
+    if (!isName(key))
+        return fail("Invalid attribute name " + key.str() + "\n");
+    _out.put(' ');
+    _out.put(key);
+    _out.put("=\"", 2);
+    _out.putEscaped(value, true);
+    _out.put('"');
+    return true;
+}
+
+bool Xsea::XmlWriter::text(StringRef value) {
+    if (!_error.empty())
+        return false;
+    if (_nameStarts.empty())
+        return fail("Text outside the root element\n");
+    return nonelement(NodeType::_text, value);
+}
+
+bool Xsea::XmlWriter::comment(StringRef value) {
+    if (!_error.empty())
+        return false;
+    for (std::size_t i = 0; i + 1 < value.size(); i++)
+        if (value[i] == '-' && value[i + 1] == '-')
+            return fail("Comment containing --\n");
+    if (!value.empty() && value.back() == '-')
+        return fail("Comment ending with -\n");
+    return nonelement(NodeType::_comment, value);
+}
+
+bool Xsea::XmlWriter::unknown(StringRef value) {
+    if (!_error.empty())
+        return false;
+    return nonelement(NodeType::_unknown, value);
+}
+
+bool Xsea::XmlWriter::cdata(StringRef value) {
+    if (!_error.empty())
+        return false;
+    if (_nameStarts.empty())
+        return fail("CDATA outside the root element\n");
+    return nonelement(NodeType::_cdata, value);
+}
+
+bool Xsea::XmlWriter::processingInstruction(StringRef value) {
+    if (!_error.empty())
+        return false;
+    std::size_t target = 0;
+    while (target < value.size() && value[target] != ' ' && value[target] != '\t' && value[target] != '\r' &&
+           value[target] != '\n')
+        target++;
+    if (!isName(value.substr(0, target)))
+        return fail("Invalid processing instruction target in " + value.str() + "\n");
+    for (std::size_t i = 0; i + 1 < value.size(); i++)
+        if (value[i] == '?' && value[i + 1] == '>')
+            return fail("Processing instruction containing ?>\n");
+    return nonelement(NodeType::_instruction, value);
+}
+
+bool Xsea::XmlWriter::doctype(StringRef value) {
+    if (!_error.empty())
+        return false;
+    if (!_nameStarts.empty() || _rootDone)
+        return fail("DOCTYPE after the root element started\n");
+    return nonelement(NodeType::_doctype, value);
+}
+
+bool Xsea::XmlWriter::endElement() {
+    if (!_error.empty())
+        return false;
+    if (_nameStarts.empty())
+        return fail("Back tag without an open element\n");
+    std::size_t depth = _nameStarts.size() - 1;
+    StringRef name(_names.data() + _nameStarts.back(), _names.size() - _nameStarts.back());
+    if (_tagOpen) {
+        _out.put("/>", 2);
+    } else {
+        if (_heldType != NodeType::_node) { // a single text or comment stays with its tags when short
+            std::size_t size = _heldType == NodeType::_text ? OutputBuffer::escapedSize(_held, false) : _held.size();
+            bool inline_ = !_pretty || size < 40;
+            if (!inline_) {
+                newline();
+                indent(depth + 1);
+            }
+            putHeld();
+            if (!inline_) {
+                newline();
+                indent(depth);
+            }
+        } else {
+            indent(depth);
+        }
+        _out.put("</", 2);
+        _out.put(name);
+        _out.put('>');
+    }
+    if (_flat == depth + 1) { // the element that held text is done, lay out again
+        _pretty = true;
+        _flat = 0;
+    }
+    newline();
+    _names.resize(_nameStarts.back());
+    _nameStarts.pop_back();
+    _tagOpen = false;
+    _broken = true; // the parent had an element child
+    if (_nameStarts.empty())
+        _rootDone = true;
+    return true;
+}
+
+bool Xsea::XmlWriter::endElement(StringRef name) {
+    if (!_error.empty())
+        return false;
+    if (_nameStarts.empty())
+        return fail("Back tag </" + name.str() + "> without an open element\n");
+    StringRef open(_names.data() + _nameStarts.back(), _names.size() - _nameStarts.back());
+    if (open != name)
+        return fail("Back tag </" + name.str() + "> doesn't match <" + open.str() + ">\n");
+    return endElement();
+}
+
+bool Xsea::XmlWriter::finish() {
+    if (!_error.empty())
+        return false;
+    if (!_nameStarts.empty())
+        return fail("Unclosed tag <" + _names.substr(_nameStarts.back()) + ">\n");
+    if (!_rootDone)
+        return fail("No root\n");
+    if (!_out.flush())
+        return fail("Cannot write the output\n");
+    return true;
+}
+
+std::size_t Xsea::XmlWriter::depth() const {
+    return _nameStarts.size();
+}
+
+bool Xsea::XmlWriter::good() const {
+    return _error.empty() && _out.good();
+}
+
+std::string Xsea::XmlWriter::getError() const {
+    return _error;
+}
+
+const char *Xsea::XmlWriter::getErrorC() const {
+    return _error.c_str();
+}
+
+bool Xsea::XmlWriter::nonelement(NodeType type, StringRef value) {
+    if (_nameStarts.empty()) { // beside the root, one per line
+        putNonelement(type, value);
+        newline();
+        _started = true;
+        return true;
+    }
+    if (_pretty && (type == NodeType::_text || type == NodeType::_cdata)) { // text is content, no layout from here on
+        _pretty = false;
+        _flat = _nameStarts.size();
+    }
+    if (!child(false))
+        return false;
+    if (_broken) {
+        indent(_nameStarts.size());
+        putNonelement(type, value);
+        newline();
+    } else {
+        _heldType = type;
+        _held.clear();
+        _held.append(value.data(), value.size());
+    }
+    return true;
+}
+
+bool Xsea::XmlWriter::child(bool element) {
+    if (_nameStarts.empty())
+        return true;
+    if (_tagOpen) {
+        _out.put('>');
+        _tagOpen = false;
+        if (element) { // the first child is an element, so every child gets a line
+            newline();
+            _broken = true;
+        }
+        return true;
+    }
+    if (_heldType != NodeType::_node) { // a second child, the held one gets its own line after all
+        newline();
+        indent(_nameStarts.size());
+        putHeld();
+        newline();
+        _broken = true;
+    }
+    return true;
+}
+
+void Xsea::XmlWriter::putHeld() {
+    putNonelement(_heldType, _held);
+    _heldType = NodeType::_node;
+}
+
+void Xsea::XmlWriter::putNonelement(NodeType type, StringRef value) {
+    switch (type) {
+        case NodeType::_text:
+            _out.putEscaped(value, false);
+            return;
+        case NodeType::_comment:
+            _out.put("<!--", 4);
+            _out.put(value);
+            _out.put("-->", 3);
+            return;
+        case NodeType::_unknown:
+            _out.put('<');
+            _out.put(value);
+            _out.put('>');
+            return;
+        case NodeType::_cdata:
+            _out.putCData(value);
+            return;
+        case NodeType::_instruction:
+            _out.put("<?", 2);
+            _out.put(value);
+            _out.put("?>", 2);
+            return;
+        case NodeType::_doctype:
+            _out.put("<!DOCTYPE ", 10);
+            _out.put(value);
+            _out.put('>');
+            return;
+        default:
+            return;
+    }
+}
+
+void Xsea::XmlWriter::newline() {
+    if (_pretty)
+        _out.put('\n');
+}
+
+void Xsea::XmlWriter::indent(std::size_t depth) {
+    if (!_pretty)
+        return;
+    std::size_t n = depth * _indent;
+    if (_spaces.size() < n)
+        _spaces.resize(n * 2, ' ');
+    _out.put(_spaces.data(), n);
+}
+
+bool Xsea::XmlWriter::fail(const std::string &message) {
+    _error += message;
+    return false;
+}
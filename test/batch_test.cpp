@@ -0,0 +1,39 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+int main() {
+    std::string good = "batch_test_good.xml";
+    std::string empty = "batch_test_empty.xml";
+    std::ofstream(good) << "<r><a k='1'/></r>";
+    std::ofstream(empty).flush();
+
+    // a directory opens as a file but has nothing to read, the others still load
+    DocumentBatch batch = DocumentBatch::loadMany({good, ".", "batch_test_missing.xml", empty, good}, 2);
+    std::remove(good.c_str());
+    std::remove(empty.c_str());
+    CHECK(batch.size() == 5);
+    CHECK(batch.good(0) && batch.good(4));
+    CHECK(batch.getDocument(0).findAll("a").size() == 1 && batch.getDocument(4).findAll("a").size() == 1);
+    CHECK(!batch.good(1) && batch.getError(1).find("Cannot read file .") != std::string::npos);
+    CHECK(!batch.good(2) && batch.getError(2).find("Cannot open file") != std::string::npos);
+    CHECK(!batch.good(3) && !batch.getError(3).empty());
+    CHECK(batch.getFailed() == (std::vector<std::size_t>{1, 2, 3}));
+
+    // buffers, borrowed and owned, load beside the files
+    std::string xml = "<x/>";
+    batch.addBuffer(xml.data(), xml.size());
+    batch.addBuffer(std::string("<y><z/></y>"));
+    batch.addBuffer(std::string("<broken>"));
+    CHECK(!batch.load());
+    CHECK(batch.size() == 8 && batch.good(5) && batch.good(6) && !batch.good(7));
+    CHECK(batch.getDocument(6).findAll("z").size() == 1);
+
+    // every Document has its own names
+    CHECK(batch.getDocument(0).getNameTable() != batch.getDocument(4).getNameTable());
+    return 0;
+}
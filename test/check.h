@@ -0,0 +1,15 @@
+#ifndef XSEA_TEST_CHECK_H
+#define XSEA_TEST_CHECK_H
+
+#include <cstdio>
+
+// report the failed condition and leave main with a failure
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            return 1; \
+        } \
+    } while (0)
+
+#endif //XSEA_TEST_CHECK_H
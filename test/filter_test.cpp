@@ -0,0 +1,50 @@
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+class Collector : public PathHandler {
+public:
+    std::vector<std::pair<std::size_t, std::string>> found;
+
+    bool match(std::size_t path, StringRef value) override {
+        found.emplace_back(path, value.str());
+        return true;
+    }
+};
+
+typedef std::vector<std::pair<std::size_t, std::string>> Matches;
+
+Matches run(const std::vector<std::string> &paths, const std::string &xml) {
+    Collector collector;
+    PathFilter filter(collector);
+    for (const std::string &path : paths)
+        filter.add(path);
+    filter.parse(xml.data(), xml.size());
+    return collector.found;
+}
+
+}
+
+int main() {
+    // the // edge of the top keeps looping, the child edge beside it does not
+    CHECK(run({"/a/text()", "//b/text()"}, "<r><a>WRONG</a><b>ok</b><x><b>deep</b></x></r>") ==
+          (Matches{{1, "ok"}, {1, "deep"}}));
+
+    // the same below an inner node
+    CHECK(run({"/a//b/text()", "/a/c/text()"}, "<a><x><c>WRONG</c></x><c>ok</c><x><b>deep</b></x></a>") ==
+          (Matches{{1, "ok"}, {0, "deep"}}));
+
+    // nothing ends below a node that loops
+    CHECK(run({"/a/text()", "/a//b/@k"}, "<a><x k='1'>WRONG</x>top<b k='2'/></a>") ==
+          (Matches{{0, "top"}, {1, "2"}}));
+
+    // a // after a // still matches at any depth
+    CHECK(run({"//a//b/text()"}, "<r><a><x><b>1</b></x></a><b>WRONG</b></r>") == (Matches{{0, "1"}}));
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <string>
+#include <vector>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+// the k attribute of each element, in the order given
+std::string keys(const std::vector<ElementHandle> &elements) {
+    std::string out;
+    for (ElementHandle elem : elements) {
+        const Attribute *attr = elem->findAttribute("k");
+        out += attr != nullptr ? attr->getValue() : std::string("-");
+    }
+    return out;
+}
+
+}
+
+int main() {
+    Document doc;
+    std::string xml = "<r><a k='1'><a k='2'/></a><b k='1'/><a k='3'/><a/></r>";
+    CHECK(doc.loadBuffer(xml.data(), xml.size()));
+
+    // tag lists in document order, values per tag and key
+    CHECK(keys(doc.findAll("a")) == "123-" && keys(doc.findAll("b")) == "1");
+    CHECK(doc.findAll("a", "k", "1").size() == 1 && doc.findAll("b", "k", "1").size() == 1);
+    CHECK(doc.findFirst("a", "k", "3") == doc.findAll("a")[2]);
+    CHECK(doc.findAll("missing").empty() && doc.findAll("a", "k", "9").empty());
+    CHECK(doc.findFirst("a", "missing", "1") == nullptr);
+
+    // edits keep the built lists current, new elements land at their place in document order
+    Element &root = doc.getRoot();
+    ElementHandle first = doc.findAll("a").front();
+    NodePtr added = root.insertBefore(root.backHandle(), NodeType::_element, "a");
+    static_cast<Element &>(*added).addAttribute(Attribute("k", "4"));
+    CHECK(keys(doc.findAll("a")) == "1234-" && doc.findAll("a", "k", "4").front() == added.get());
+    CHECK(first->add(NodeType::_element, "a") != nullptr && keys(doc.findAll("a")) == "12-34-");
+    NodePtr gone = root.unlink(first);
+    CHECK(keys(doc.findAll("a")) == "34-" && doc.findAll("a", "k", "1").empty());
+    CHECK(root.moveChild(0, first) != nullptr && keys(doc.findAll("a")) == "12-34-");
+    CHECK(doc.findAll("a", "k", "1").front() == first);
+
+    // renames move an element between the lists
+    added->setValue("b");
+    CHECK(keys(doc.findAll("a")) == "12-3-" && keys(doc.findAll("b")) == "14");
+    CHECK(doc.findAll("b", "k", "4").front() == added.get() && doc.findAll("a", "k", "4").empty());
+
+    // attributes edited in place are seen on the next lookup
+    doc.findAll("b").front()->getAllAttributes().front() = Attribute("k", "7");
+    CHECK(doc.findAll("b", "k", "7").size() == 1 && doc.findAll("b", "k", "1").empty());
+
+    // many siblings inserted in the middle stay ordered
+    Element &mid = static_cast<Element &>(*root.add(NodeType::_element, "m"));
+    for (int i = 0; i < 1000; i++)
+        mid.add(NodeType::_element, "c");
+    CHECK(doc.findAll("c").size() == 1000);
+    for (int i = 0; i < 100; i++)
+        mid.insert(500, NodeType::_element, "c");
+    const std::vector<ElementHandle> &cs = doc.findAll("c");
+    CHECK(cs.size() == 1100);
+    for (std::size_t i = 1; i < cs.size(); i++)
+        CHECK(cs[i - 1]->nextHandle() == cs[i]);
+
+    // dropped and built again, and a new load starts over
+    doc.dropIndexes();
+    CHECK(keys(doc.findAll("a")) == "12-3-" && doc.findAll("c").size() == 1100);
+    xml = "<r><a k='9'/></r>";
+    CHECK(doc.loadBuffer(xml.data(), xml.size()));
+    CHECK(keys(doc.findAll("a")) == "9" && doc.findAll("c").empty());
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+std::string saved(const Document &doc) {
+    std::string out;
+    SaveOptions options;
+    options.pretty = false;
+    doc.saveBuffer(out, options);
+    return out;
+}
+
+// what a save and load would make of the namespaces
+std::size_t reloaded(const Document &doc, StringRef ns, StringRef local) {
+    std::string out = saved(doc);
+    Document again;
+    again.loadBuffer(out.data(), out.size());
+    return again.findAll(ns, local).size();
+}
+
+}
+
+int main() {
+    // within one Document the subtree moves as it is, the index follows
+    Document doc;
+    std::string xml = "<r><a><x k='1'/></a><b/></r>";
+    CHECK(doc.loadBuffer(xml.data(), xml.size()));
+    Element &root = doc.getRoot();
+    ElementHandle a = doc.findAll("a").front();
+    ElementHandle b = doc.findAll("b").front();
+    ElementHandle x = doc.findAll("x").front();
+    CHECK(doc.findAll("x", "k", "1").size() == 1);
+    CHECK(b->moveChild(x) != nullptr && x->parentHandle() == b);
+    CHECK(saved(doc) == "<r><a/><b><x k=\"1\"/></b></r>");
+    CHECK(doc.findAll("x", "k", "1").front() == x);
+    CHECK(root.moveChild(0, b) != nullptr && root.frontHandle() == b);
+    CHECK(a->moveChild(&root) == nullptr && x->moveChild(b) == nullptr); // not into itself
+    CHECK(a->splice(nullptr, root, b, nullptr) == 0); // the run would take a itself
+    CHECK(a->splice(nullptr, root, b, b) == 1 && saved(doc) == "<r><a><b><x k=\"1\"/></b></a></r>");
+
+    // between two declarations of the same prefix in one Document
+    Document scoped;
+    xml = "<r><u xmlns:p='urn:1'><p:e/></u><v xmlns:p='urn:2'/></r>";
+    CHECK(scoped.loadBuffer(xml.data(), xml.size()));
+    CHECK(scoped.findAll("urn:1", "e").size() == 1);
+    CHECK(scoped.findAll("v").front()->moveChild(scoped.findAll("p:e").front()) != nullptr);
+    CHECK(scoped.findAll("urn:1", "e").empty() && scoped.findAll("urn:2", "e").size() == 1);
+
+    // from another Document, an unprefixed element takes the default namespace it lands in
+    Document target;
+    xml = "<r xmlns='urn:d' xmlns:p='urn:p'><p:s/></r>";
+    CHECK(target.loadBuffer(xml.data(), xml.size()));
+    Document source;
+    xml = "<o xmlns:p='urn:other'><a/><p:y><z/></p:y><q:w xmlns:q='urn:q'/></o>";
+    CHECK(source.loadBuffer(xml.data(), xml.size()));
+    CHECK(source.findAll("", "a").size() == 1 && source.findAll("urn:other", "y").size() == 1);
+    Element &top = target.getRoot();
+    CHECK(top.moveChild(source.findAll("a").front()) != nullptr);
+    CHECK(target.findAll("urn:d", "a").size() == 1 && reloaded(target, "urn:d", "a") == 1);
+    CHECK(source.findAll("", "a").empty());
+
+    // a prefix means what it is bound to here, the descendants follow, their own declarations stay
+    CHECK(top.splice(nullptr, source.getRoot(), source.findAll("p:y").front(), nullptr) == 2);
+    CHECK(target.findAll("urn:p", "y").size() == 1 && target.findAll("urn:other", "y").empty());
+    CHECK(target.findAll("urn:d", "z").size() == 1 && reloaded(target, "urn:d", "z") == 1);
+    CHECK(target.findAll("urn:q", "w").size() == 1 && reloaded(target, "urn:q", "w") == 1);
+    CHECK(source.getRoot().frontHandle() == nullptr);
+
+    // out of the default namespace and back, through a detached subtree
+    ElementHandle s = target.findAll("p:s").front();
+    ElementHandle moved = target.findAll("a").front();
+    NodePtr held = top.unlink(moved);
+    CHECK(held != nullptr && moved->parentHandle() == nullptr);
+    CHECK(source.getRoot().moveChild(moved) != nullptr);
+    CHECK(source.findAll("", "a").size() == 1 && reloaded(source, "", "a") == 1);
+    CHECK(s->moveChild(moved) != nullptr && target.findAll("urn:d", "a").size() == 1);
+    CHECK(reloaded(target, "urn:d", "a") == 1 && reloaded(target, "urn:p", "s") == 1);
+
+    // a copy binds where it is linked too
+    Document other;
+    xml = "<c><d/></c>";
+    CHECK(other.loadBuffer(xml.data(), xml.size()));
+    CHECK(top.link(other.getRootPtr()) != nullptr);
+    CHECK(target.findAll("urn:d", "d").size() == 1 && other.findAll("", "d").size() == 1);
+    CHECK(reloaded(target, "urn:d", "d") == 1);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <memory>
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+int main() {
+    // the same name is one id, whoever interns it
+    NameTable table;
+    NameId a = table.intern("a");
+    CHECK(table.intern(std::string("a")) == a && table.find("a") == a && table.intern("b") != a);
+    CHECK(table.name(a) == StringRef("a") && table.size() == 2 && table.find("c") == noName);
+    CHECK(table.prefixOf(table.intern("p:x")) == table.find("p") && table.localOf(table.find("p:x")) == table.find("x"));
+    CHECK(table.prefixOf(a) == noName && table.localOf(a) == a);
+
+    // Documents that share a table agree on the ids
+    auto shared = std::make_shared<NameTable>();
+    Document one, two;
+    one.setNameTable(shared);
+    two.setNameTable(shared);
+    std::string xml = "<r><item k='1'/></r>";
+    CHECK(one.loadBuffer(xml.data(), xml.size()) && two.loadBuffer(xml.data(), xml.size()));
+    CHECK(one.getNameTable() == shared && two.getNameTable() == shared);
+    CHECK(one.findAll("item").front()->getNameId() == two.findAll("item").front()->getNameId());
+
+    // clear drops the children and attributes, the name and its ids stay
+    Element &root = one.getRoot();
+    NameId rootId = root.getNameId();
+    root.clear();
+    CHECK(root.getValue() == "r" && root.getNameId() == rootId && !root.hasChildren());
+    CHECK(one.findAll("r").size() == 1 && one.findAll("item").empty());
+    std::string out;
+    SaveOptions options;
+    options.pretty = false;
+    one.saveBuffer(out, options);
+    CHECK(out == "<r/>");
+
+    // and a cleared element leaves the namespace it declared itself
+    Document ns;
+    xml = "<p:r xmlns:p='urn:p'><p:x/></p:r>";
+    CHECK(ns.loadBuffer(xml.data(), xml.size()));
+    CHECK(ns.findAll("urn:p", "r").size() == 1);
+    ns.getRoot().clear();
+    CHECK(ns.findAll("urn:p", "r").empty() && ns.findAll("p:r").size() == 1);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+const char *soap = "http://schemas.xmlsoap.org/soap/envelope/";
+
+std::string uri(NameTable &names, NameId id) {
+    return id == noName ? "-" : names.name(id).str();
+}
+
+}
+
+int main() {
+    std::string xml = "<soap:Envelope xmlns:soap='http://schemas.xmlsoap.org/soap/envelope/' xmlns='urn:d'>"
+                      "<soap:Header><h xmlns=''><x/></h></soap:Header>"
+                      "<soap:Body><m:Get xmlns:m='urn:m' m:id='1' plain='2' xml:lang='en'><m:Item/><Item/></m:Get>"
+                      "<s2:Fault xmlns:s2='http://schemas.xmlsoap.org/soap/envelope/'/><u:v/></soap:Body>"
+                      "</soap:Envelope>";
+
+    // the same tree whether loaded at once, from a stream or fed in pieces
+    for (int mode = 0; mode < 3; mode++) {
+        Document doc;
+        std::istringstream is(xml);
+        bool ok = mode == 0 ? doc.loadBuffer(xml.data(), xml.size()) : mode == 1 ? doc.load(is)
+                : doc.feed(xml.data(), 37) && doc.feed(xml.data() + 37, xml.size() - 37) && doc.finish();
+        CHECK(ok);
+        NameTable &names = *doc.getNameTable();
+        ElementHandle envelope = doc.findFirst(soap, "Envelope");
+        CHECK(envelope != nullptr && names.name(envelope->getLocalNameId()) == StringRef("Envelope"));
+        CHECK(doc.findAll(soap, "Fault").size() == 1); // another prefix for the same URI
+        CHECK(doc.findAll("urn:m", "Item").size() == 1 && doc.findAll("urn:d", "Item").size() == 1);
+        CHECK(doc.findAll("", "h").size() == 1 && doc.findAll("", "x").size() == 1); // xmlns='' takes it away
+        CHECK(doc.findAll("", "u:v").empty() && doc.findAll("", "v").size() == 1); // undeclared prefix
+        CHECK(doc.findAll("urn:none", "Item").empty());
+
+        // attributes: a prefix binds, no prefix is no namespace, xml and xmlns are always bound
+        ElementHandle get = doc.findFirst("urn:m", "Get");
+        CHECK(get != nullptr);
+        CHECK(uri(names, get->findAttribute("m:id")->getNamespaceId()) == "urn:m");
+        CHECK(uri(names, get->findAttribute("plain")->getNamespaceId()) == "-");
+        CHECK(uri(names, get->findAttribute("xml:lang")->getNamespaceId()) == "http://www.w3.org/XML/1998/namespace");
+        CHECK(uri(names, get->findAttribute("xmlns:m")->getNamespaceId()) == "http://www.w3.org/2000/xmlns/");
+    }
+
+    Document doc;
+    CHECK(doc.loadBuffer(xml.data(), xml.size()));
+    NameTable &names = *doc.getNameTable();
+    ElementHandle get = doc.findFirst("urn:m", "Get");
+
+    // a new element binds where it is added, a rename binds again
+    NodePtr added = get->add(NodeType::_element, "m:Item");
+    CHECK(static_cast<Element &>(*added).getNamespaceId() == names.find("urn:m"));
+    CHECK(doc.findAll("urn:m", "Item").size() == 2);
+    added->setValue("Item");
+    CHECK(doc.findAll("urn:m", "Item").size() == 1 && doc.findAll("urn:d", "Item").size() == 2);
+
+    // a declaration added later reaches the element and its descendants
+    auto &item = static_cast<Element &>(*added);
+    item.add(NodeType::_element, "leaf");
+    item.addAttribute(Attribute("xmlns", "urn:z"));
+    CHECK(doc.findAll("urn:z", "Item").size() == 1 && doc.findAll("urn:z", "leaf").size() == 1);
+    CHECK(doc.findAll("urn:d", "Item").size() == 1 && doc.findAll("urn:d", "leaf").empty());
+
+    // on an ancestor, also when the index was built before the declaration
+    std::string plain = "<r><p:x><p:x/></p:x><q xmlns:p='urn:o'><p:x/></q></r>";
+    for (int early = 0; early < 2; early++) {
+        Document later;
+        CHECK(later.loadBuffer(plain.data(), plain.size()));
+        if (early)
+            CHECK(later.findAll("urn:p", "x").empty());
+        later.getRoot().addAttribute(Attribute("xmlns:p", "urn:p"));
+        CHECK(later.findAll("urn:p", "x").size() == 2 && later.findAll("urn:o", "x").size() == 1);
+
+        // edited in place, taking the declaration away again
+        later.getRoot().getAllAttributes().clear();
+        CHECK(later.findAll("r").front()->findAttribute("xmlns:p") == nullptr);
+        CHECK(later.findAll("urn:p", "x").empty() && later.findAll("", "x").size() == 2); // p is undeclared
+        CHECK(later.findAll("urn:o", "x").size() == 1);
+
+        // replaced in place during a value lookup
+        ElementHandle q = later.findAll("q").front();
+        q->getAllAttributes().front() = Attribute("xmlns:p", "urn:n");
+        CHECK(later.findAll("q", "xmlns:p", "urn:n").size() == 1);
+        CHECK(later.findAll("urn:n", "x").size() == 1 && later.findAll("urn:o", "x").empty());
+    }
+
+    // queries match the expanded names
+    std::vector<NodeHandle> out;
+    CHECK(Query("//{urn:m}Get/{urn:m}Item").select(doc, out) == 1 && out[0]->getValueRef() == StringRef("m:Item"));
+    CHECK(Query("/{" + std::string(soap) + "}Envelope/*/{" + soap + "}Fault").first(doc) != nullptr);
+    CHECK(!Query("//{urn:m").good());
+
+    // copies keep their ids, a snapshot keeps them too
+    NodePtr copy = get->deepClone();
+    CHECK(static_cast<Element &>(*copy).getNamespaceId() == get->getNamespaceId());
+    const std::string snapshot = "namespace_test.bin"; // a non-const string picks the overload that appends to it
+    CHECK(doc.saveBinary(snapshot));
+    Document back;
+    bool loaded = back.loadBinary(snapshot);
+    std::remove(snapshot.c_str());
+    CHECK(loaded && back.findAll(soap, "Fault").size() == 1 && back.findAll("urn:z", "leaf").size() == 1);
+    return 0;
+}
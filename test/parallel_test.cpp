@@ -0,0 +1,91 @@
+#include <stdexcept>
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+// items whose CDATA is full of '<', so nearly every split lands inside a section
+std::string cdataHeavy(std::size_t size) {
+    std::string body;
+    for (int i = 0; i < 2000; i++)
+        body += "<b x='1'>";
+    std::string xml = "<root>";
+    for (std::size_t n = 0; xml.size() < size; n++)
+        xml += "<item n=\"" + std::to_string(n) + "\"><![CDATA[" + body + "]]></item>";
+    xml += "</root>";
+    return xml;
+}
+
+class Counter : public SaxHandler {
+public:
+    std::size_t elements = 0;
+    std::size_t sections = 0;
+
+    bool startElement(StringRef, const std::vector<Attribute> &) override {
+        elements++;
+        return true;
+    }
+
+    bool cdata(StringRef) override {
+        sections++;
+        return true;
+    }
+};
+
+class Thrower : public SaxHandler {
+public:
+    bool startElement(StringRef, const std::vector<Attribute> &) override {
+        if (++_seen == 100000)
+            throw std::runtime_error("handler failed");
+        return true;
+    }
+
+private:
+    std::size_t _seen = 0;
+};
+
+}
+
+int main() {
+    std::string xml = cdataHeavy(40 * 1024 * 1024);
+
+    // splits inside CDATA are tokenized again, past the retry limit the rest goes serially
+    Counter serial;
+    CHECK(SaxParser(serial).parse(xml.data(), xml.size()));
+    Counter parallel;
+    SaxParser parser(parallel);
+    CHECK(parser.parseParallel(xml.data(), xml.size(), 4));
+    CHECK(parallel.elements == serial.elements);
+    CHECK(parallel.sections == serial.sections);
+    CHECK(parallel.sections + 1 == parallel.elements);
+
+    // the same tree either way
+    ParseOptions options;
+    options.threads = 4;
+    Document one, four;
+    four.setParseOptions(options);
+    CHECK(one.loadBuffer(xml.data(), xml.size()));
+    CHECK(four.loadBuffer(xml.data(), xml.size()));
+    std::string a, b;
+    one.saveBuffer(a);
+    four.saveBuffer(b);
+    CHECK(a == b);
+
+    // a throwing handler leaves through the exception, the workers are joined on the way
+    std::string plain = "<root>";
+    while (plain.size() < 12 * 1024 * 1024)
+        plain += "<item><a>text</a></item>";
+    plain += "</root>";
+    Thrower thrower;
+    bool thrown = false;
+    try {
+        SaxParser(thrower).parseParallel(plain.data(), plain.size(), 4);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    return 0;
+}
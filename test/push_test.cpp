@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+// every event as one line, with the attributes of start tags
+class Recorder : public SaxHandler {
+public:
+    std::string log;
+    std::string stopAt; // stop at the start of this element
+
+    bool startElement(StringRef name, const std::vector<Attribute> &attributes) override {
+        log += "<" + name.str();
+        for (const Attribute &attr : attributes)
+            log += " " + attr.getKey() + "=" + attr.getValue();
+        log += "\n";
+        return name != StringRef(stopAt);
+    }
+
+    bool endElement(StringRef name) override {
+        log += "</" + name.str() + "\n";
+        return true;
+    }
+
+    bool text(StringRef value) override {
+        log += "t " + value.str() + "\n";
+        return true;
+    }
+
+    bool comment(StringRef value) override {
+        log += "c " + value.str() + "\n";
+        return true;
+    }
+
+    bool processingInstruction(StringRef value) override {
+        log += "? " + value.str() + "\n";
+        return true;
+    }
+};
+
+// the events of xml fed in chunks of size bytes, with a trailing ! when finish failed
+std::string pushed(const std::string &xml, std::size_t size) {
+    Recorder recorder;
+    PushParser parser(recorder);
+    for (std::size_t pos = 0; pos < xml.size(); pos += size) {
+        if (!parser.feed(xml.data() + pos, std::min(size, xml.size() - pos)))
+            break;
+    }
+    if (!parser.finish())
+        recorder.log += "!";
+    return recorder.log;
+}
+
+}
+
+int main() {
+    // a token may be cut anywhere, inside quotes, references, comments and CDATA too
+    std::string xml = "<?xml version='1.0'?><r a='x>y' b=\"&amp;&#65;\"><!-- a -- b --><x>t&lt;u&gt;</x>"
+                      "<![CDATA[c]]d]]>]]><?pi data?><y/>tail</r>";
+    std::string whole = pushed(xml, xml.size());
+    CHECK(whole.find("<r a=x>y b=&A\n") != std::string::npos && whole.find("t t<u>\n") != std::string::npos);
+    CHECK(whole.find("t c]]d\n") != std::string::npos && whole.back() != '!');
+    for (std::size_t size = 1; size < 24; size++)
+        CHECK(pushed(xml, size) == whole);
+
+    // errors show at the feed that completes them, or at finish for an input cut short
+    CHECK(pushed("<r><x></y></r>", 3).back() == '!');
+    CHECK(pushed("<r><x>", 2).back() == '!');
+    CHECK(pushed("<r><x a='1", 4).back() == '!');
+    CHECK(pushed("", 1).back() == '!'); // no root
+
+    // the handler stops the parse, later feeds do nothing
+    Recorder recorder;
+    recorder.stopAt = "x";
+    PushParser parser(recorder);
+    CHECK(!parser.feed("<r><x/><y/></r>", 15));
+    CHECK(!parser.feed("<z/>", 4) && recorder.log == "<r\n<x\n");
+
+    // restart takes a new document, after an error too
+    recorder.stopAt.clear();
+    recorder.log.clear();
+    parser.restart();
+    CHECK(parser.feed("<a>1</a", 7) && parser.feed(">", 1) && parser.finish() && parser.good());
+    CHECK(recorder.log == "<a\nt 1\n</a\n");
+    parser.restart();
+    CHECK(!parser.feed("<a></b>", 7) && !parser.good() && !parser.getError().empty());
+    parser.restart();
+    recorder.log.clear();
+    CHECK(parser.feed("<b/>", 4) && parser.finish() && recorder.log == "<b\n</b\n");
+
+    // a Document fed chunk by chunk holds the same tree as one loaded at once
+    Document loaded, fed;
+    CHECK(loaded.loadBuffer(xml.data(), xml.size()));
+    for (std::size_t pos = 0; pos < xml.size(); pos += 5)
+        CHECK(fed.feed(xml.data() + pos, std::min<std::size_t>(5, xml.size() - pos)));
+    CHECK(fed.finish());
+    std::string a, b;
+    loaded.saveBuffer(a);
+    fed.saveBuffer(b);
+    CHECK(a == b && fed.findAll("y").size() == 1);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+typedef std::vector<std::string> Values;
+
+Values values(Document &doc, const std::string &path) {
+    Values found;
+    std::vector<StringRef> refs;
+    Query(path).values(doc, refs);
+    for (StringRef ref : refs)
+        found.push_back(ref.str());
+    return found;
+}
+
+}
+
+int main() {
+    Document doc;
+    std::string xml = "<r><a id='1'><a id='2'><b>inner</b></a><b>outer</b></a>"
+                      "<c k='x'><d>1</d><d>2</d><d>3</d></c><c><d>4</d></c></r>";
+    CHECK(doc.loadBuffer(xml.data(), xml.size()));
+
+    // nested same-name ancestors, every match in document order whichever context reached it
+    CHECK(values(doc, "//a/b") == (Values{"inner", "outer"}));
+    CHECK(values(doc, "//a//b") == (Values{"inner", "outer"})); // reached twice, kept once
+    CHECK(values(doc, "//a/@id") == (Values{"1", "2"}));
+    NodeHandle first = Query("//a/b").first(doc);
+    CHECK(first != nullptr && first->getType() == NodeType::_element);
+    std::vector<StringRef> text;
+    CHECK(Query("text()").values(static_cast<Element &>(*first), text) == 1 && text.front() == StringRef("inner"));
+    std::vector<NodeHandle> nodes;
+    CHECK(Query("//a/b").select(doc, nodes) == 2 && nodes.front() == first);
+
+    // child steps and predicates
+    CHECK(values(doc, "/r/c/d") == (Values{"1", "2", "3", "4"}));
+    CHECK(values(doc, "/r/c[@k='x']/d[2]") == (Values{"2"}));
+    CHECK(values(doc, "/r/c/d[last()]") == (Values{"3", "4"}));
+    CHECK(values(doc, "/r/c[@k!='x']/d").empty()); // false without the attribute
+    CHECK(values(doc, "//d[text()='4']") == (Values{"4"}));
+    CHECK(values(doc, "/r/*[@k]/@k") == (Values{"x"}));
+
+    // relative to an element, an absolute path still starts at the top
+    Element &c = *doc.findAll("c").front();
+    text.clear();
+    CHECK(Query("d[1]").values(c, text) == 1 && text.front() == StringRef("1"));
+    nodes.clear();
+    CHECK(Query("/r/a").select(c, nodes) == 1);
+
+    // names the document never saw, and expressions outside the subset
+    CHECK(values(doc, "//missing").empty() && Query("//missing").first(doc) == nullptr);
+    CHECK(!Query("/r/../a").good() && !Query("/r/@k/d").good() && !Query("/r/d[0]").good());
+    CHECK(!Query("").good() && !Query("/r/d[").good());
+
+    // expanded names match the namespace, not the prefix
+    Document ns;
+    xml = "<p:r xmlns:p='urn:p'><q:x xmlns:q='urn:p'>1</q:x><x>2</x></p:r>";
+    CHECK(ns.loadBuffer(xml.data(), xml.size()));
+    CHECK(values(ns, "/{urn:p}r/{urn:p}x") == (Values{"1"}));
+    CHECK(values(ns, "//{}x") == (Values{"2"}));
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include "../include/xsea.h"
+#include "check.h"
+
+using namespace Xsea;
+
+namespace {
+
+// the events of a loaded tree, in document order
+void write(XmlWriter &writer, const Node &node) {
+    switch (node.getType()) {
+        case NodeType::_element: {
+            const auto &elem = static_cast<const Element &>(node);
+            writer.startElement(elem.getValueRef());
+            for (const Attribute &attr : elem.getAllAttributes())
+                writer.attribute(attr.getKeyRef(), attr.getValueRef());
+            for (const Node &child : elem.children())
+                write(writer, child);
+            writer.endElement();
+            break;
+        }
+        case NodeType::_text:
+            writer.text(node.getValueRef());
+            break;
+        case NodeType::_cdata:
+            writer.cdata(node.getValueRef());
+            break;
+        case NodeType::_comment:
+            writer.comment(node.getValueRef());
+            break;
+        default:
+            break;
+    }
+}
+
+// what XmlWriter makes of the tree against what save makes of it
+bool same(const std::string &xml) {
+    ParseOptions options;
+    options.whitespace = Whitespace::_preserve;
+    Document doc;
+    doc.setParseOptions(options);
+    if (!doc.loadBuffer(xml.data(), xml.size()))
+        return false;
+    std::string saved;
+    doc.saveBuffer(saved);
+    std::string written;
+    XmlWriter writer(written);
+    write(writer, doc.getRoot());
+    if (!writer.finish())
+        return false;
+    if (saved != written)
+        std::fprintf(stderr, "save:\n%s\nwriter:\n%s\n", saved.c_str(), written.c_str());
+    return saved == written;
+}
+
+}
+
+int main() {
+    CHECK(same("<a><p>Hello <b>bold</b> world</p></a>"));
+    CHECK(same("<a><p>x<![CDATA[y]]><i>z <u>deep</u></i></p><q><r/><s>t</s></q></a>"));
+    CHECK(same("<a><!--note-->text<b/></a>"));
+    CHECK(same("<a><long>a text far longer than the forty characters kept inline</long><e/></a>"));
+    CHECK(same("<a><c><!--a comment far longer than forty characters on its own--></c><d><x/></d></a>"));
+    return 0;
+}